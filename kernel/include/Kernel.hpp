@@ -8,8 +8,11 @@
 #include <cstdint>
 #include <proc/Context.hpp>
 #include <arch/i386/mem/MMU.hpp>
+#include <mem/SlabCache.hpp>
 #include <proc/Scheduler.hpp>
 #include <cpu/CPU.hpp>
+#include <time/Timekeeper.hpp>
+#include <time/TimerWheel.hpp>
 
 class Kernel : public Context
 {
@@ -22,25 +25,111 @@ class Kernel : public Context
      */
     void panic(char const *errorMessage);
 
+    /**
+     * Called whenever the kernel has nothing to do but wait for an interrupt.
+     * Does a small piece of background work if there is any, otherwise halts
+     * until the next interrupt. With no process waiting to run either, the
+     * timer only interrupts for the next deadline, if there is one.
+     */
+    void idle();
+
+    /**
+     * Writes a report on the kernel heap to the debug console, as `HEAPPROF`
+     * lines between `HEAPPROF BEGIN` and `HEAPPROF END`: how full each slab
+     * cache is, and in builds with LAMBOS_HEAP_PROFILER, the allocation
+     * profile. scripts/heap_profile_report.py reads it back.
+     */
+    void dumpHeapProfile() const;
+
     Scheduler& scheduler() { return lazyInitScheduler(); }
     Scheduler const& scheduler() const { return lazyInitScheduler(); }
 
+    Timekeeper& timekeeper() { return _timekeeper; }
+
     /**
-     * Allocates contiguous pages of memory.
+     * Called on every timer interrupt. Advances the tick count, fires the
+     * timers that are due and charges the tick to the running process's time
+     * slice.
+     */
+    void tick()
+    {
+        _timekeeper.interrupt();
+        runTimers();
+        if (_scheduler) { _scheduler->tick(); }
+    }
+
+    /**
+     * Arms a timer to fire at a tick (see Timekeeper::ticks()), or re-arms it
+     * if it is pending. The timer must stay alive until it fires or is
+     * cancelled.
+     */
+    void addTimer(Timer &timer, std::uint64_t expires);
+
+    /** Disarms a timer, if it's pending. */
+    void cancelTimer(Timer &timer);
+
+    /**
+     * Whether the running process should make way for another before the
+     * current interrupt or syscall returns to it.
+     */
+    bool needsReschedule() const { return _scheduler && _scheduler->needsReschedule(); }
+
+    /**
+     * Allocates contiguous pages of kernel memory.
      * @param numberOfPages The number of pages to allocate.
+     * @param flags Allocation options.
      * @return the start of the contiguous allocated memory.
      */
-    void *palloc(size_t numberOfPages) { return _mmu->palloc(addressSpace(), numberOfPages); }
+    void *palloc(size_t numberOfPages, PageAllocFlag flags = kPageAllocNone)
+    {
+        return _mmu->palloc(addressSpace(), numberOfPages, flags);
+    }
 
     /**
      * Attempts to allocate a number of pages at the given address.
      * @param virtualAddress
      * @param numberOfPages The number of pages to allocate.
+     * @param flags Allocation options.
      * @return the start of the contiguous allocated memory.
      */
-    void *palloc(void *virtualAddress, size_t numberOfPages)
+    void *palloc(void *virtualAddress, size_t numberOfPages, PageAllocFlag flags = kPageAllocNone)
+    {
+        return _mmu->palloc(addressSpace(), virtualAddress, numberOfPages, flags);
+    }
+
+    /**
+     * Reserves an area of user space which is only backed by memory when first touched.
+     * @param area The area, with its initial contents if it isn't anonymous.
+     * @return the start of the reserved memory, or nullptr.
+     */
+    void *pallocLazy(VirtualMemoryMap::Area const &area) { return _mmu->pallocLazy(addressSpace(), area); }
+
+    /**
+     * Tries to resolve a page fault in the current address space.
+     * @return true if the faulting access can be retried.
+     */
+    bool handlePageFault(std::uintptr_t faultAddress, std::uint32_t errorCode)
     {
-        return _mmu->palloc(addressSpace(), virtualAddress, numberOfPages);
+        return _mmu && _mmu->handlePageFault(addressSpace(), faultAddress, errorCode);
+    }
+
+    /**
+     * Allocates 4 MiB pages, each physically contiguous and mapped by a single
+     * page directory entry. Meant for large buffers.
+     * @param numberOfLargePages The number of 4 MiB pages to allocate.
+     * @return the start of the allocated memory, or nullptr.
+     */
+    void *pallocLarge(size_t numberOfLargePages) { return _mmu->pallocLarge(addressSpace(), numberOfLargePages); }
+
+    /**
+     * Frees memory allocated with pallocLarge().
+     * @param startOfMemoryRange The start of the memory block to free.
+     * @param numberOfLargePages The length of the memory block in 4 MiB pages.
+     * @return -1 if an error occurred, 0 otherwise.
+     */
+    int pfreeLarge(void *startOfMemoryRange, size_t numberOfLargePages)
+    {
+        return _mmu->pfreeLarge(addressSpace(), startOfMemoryRange, numberOfLargePages);
     }
 
     /**
@@ -54,9 +143,34 @@ class Kernel : public Context
         return _mmu->pfree(addressSpace(), startOfMemoryRange, numberOfPages);
     }
 
+    /**
+     * Frees a block of memory, however it was allocated.
+     * @param startOfArea The start of the block.
+     * @param numberOfPages The length of the block in pages.
+     * @return -1 if the block is not mapped, 0 otherwise.
+     */
+    int unmap(void *startOfArea, size_t numberOfPages)
+    {
+        return _mmu->unmap(addressSpace(), startOfArea, numberOfPages);
+    }
+
+    /**
+     * Checks that a block of memory lies entirely within areas that all have the given flags.
+     * @param startOfMemoryRange The start of the block.
+     * @param numberOfPages The length of the block in pages.
+     * @param flags The VirtualMemoryMap::AreaFlag values every area must have.
+     */
+    bool isMapped(void *startOfMemoryRange, size_t numberOfPages, std::uint8_t flags = VirtualMemoryMap::kAreaNone)
+    {
+        return _mmu->isMapped(addressSpace(), startOfMemoryRange, numberOfPages, flags);
+    }
+
   protected:
     Kernel() = default;
 
+    /** Fires the timers due by the current tick, and tells the timekeeper when the next is due. */
+    void runTimers();
+
     Scheduler& lazyInitScheduler() const
     {
         if (!_scheduler) { _scheduler = sys::make_unique<Scheduler>(); }
@@ -64,6 +178,9 @@ class Kernel : public Context
     }
 
     MMU *_mmu = nullptr;
+    SlabObjectAllocator _objectAllocator{};
+    Timekeeper _timekeeper{};
+    TimerWheel _timers{};
     mutable sys::UniquePtr<Scheduler> _scheduler{nullptr};
 };
 
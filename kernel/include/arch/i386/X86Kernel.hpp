@@ -23,6 +23,36 @@ public:
 
     void schedule();
 
+    /**
+     * Makes the code running now the first process, so that the scheduler has
+     * somewhere to save it when switching to others. Called once, at boot.
+     * @param name The name of the process.
+     * @param stack The bottom of the stack it runs on.
+     */
+    void adoptBootProcess(char const *name, std::byte *stack);
+
+    /**
+     * Starts a process of the current one, with an address space and kernel
+     * stack of its own. It calls `entry(argument)` with interrupts enabled,
+     * then exits when that returns.
+     * @return The process, or nullptr if it could not be created.
+     */
+    Process *spawn(char const *name, void (*entry)(void *), void *argument);
+
+    /** Ends the current process. It stays a zombie until its parent waits for it. */
+    [[noreturn]] void exitProcess();
+
+    /** Blocks until a process started with spawn() has exited, then frees it. */
+    void wait(Process &child);
+
+    /**
+     * Blocks for at least the given time without using the CPU. A process
+     * sleeps and gives the CPU to others. Code that can't be switched away
+     * from, which is only the boot code until adoptBootProcess(), halts until
+     * the time is up.
+     */
+    void sleep(std::uint64_t nanoseconds);
+
 private:
     X86::CPU _x86cpu;
     VGATextConsole _vgaConsole;
@@ -6,6 +6,7 @@
 
 #include <arch/i386/cpu/RegisterTable.h>
 #include <arch/i386/cpu/InterruptNumber.hpp>
+#include <mem/ObjectAllocator.hpp>
 #include <system/asm.h>
 
 #include <concepts>
@@ -14,7 +15,7 @@
 
 extern "C" void set_idt(void *idt, size_t size);
 
-struct InterruptServiceRoutine
+struct InterruptServiceRoutine : sys::PoolAllocated
 {
     static inline void endOfInterrupt() { outb(0x20, 0x20); }
     virtual ~InterruptServiceRoutine() {}
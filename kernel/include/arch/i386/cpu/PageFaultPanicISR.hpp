@@ -26,9 +26,13 @@ class PageFaultISR : public InterruptServiceRoutine
   public:
     virtual void operator()(RegisterTable &registers) override
     {
-        DEBUG_BREAK();
         uint32_t cr2;
         asm volatile("movl %%cr2, %0" : "=r" (cr2));
+        if (kernel->handlePageFault(cr2, registers.err_code)) {
+            return;
+        }
+
+        DEBUG_BREAK();
         sys::debug_println(PAGE_FAULT_FORMAT);
         auto message = sys::format(PAGE_FAULT_FORMAT);
         kernel->panic(message.cstr());
@@ -5,18 +5,74 @@
 #pragma once
 
 #include <arch/i386/device/pit/PITIRQ.hpp>
+#include <cpu/InterruptGuard.hpp>
+#include <time/TimerDevice.hpp>
 
-extern "C" uint16_t read_PIT_count();
+#include <algorithm>
 
 class PIT
 {
   public:
+    static constexpr uint32_t kBaseFrequency = 1193182; ///< The PIT's input clock, in Hz.
+    static constexpr uint32_t kTickRate = 100;          ///< Timer interrupts per second, and so scheduler ticks.
+
     static void installIRQ(X86::CPU &cpu) { PITIRQ::install(cpu); }
 
+    /**
+     * Makes channel 0 raise IRQ 0 periodically, as a rate generator.
+     * @param hz The number of interrupts per second, from 19 to kBaseFrequency.
+     */
+    static void setFrequency(uint32_t hz)
+    {
+        auto const divisor = std::clamp<uint32_t>(kBaseFrequency / hz, 1, 0xFFFF);
+        outb(kCommand, 0x34); // channel 0, low byte then high byte, mode 2
+        writeCount(divisor);
+    }
+
+    /**
+     * Makes channel 0 raise IRQ 0 once, after `count` input clock cycles, as
+     * an interrupt on terminal count.
+     */
+    static void startOneShot(uint32_t count)
+    {
+        outb(kCommand, 0x30); // channel 0, low byte then high byte, mode 0
+        writeCount(std::clamp<uint32_t>(count, 1, 0xFFFF));
+    }
+
+    /** Stops channel 0: in mode 0, the counter waits for a count that never comes. */
+    static void stop() { outb(kCommand, 0x30); }
+
+    /** Channel 0's current count. */
     static uint16_t readPitCount()
     {
-        return read_PIT_count();
+        InterruptGuard guard;
+        outb(kCommand, 0x00); // latch channel 0
+        auto const low = inb(kChannel0);
+        auto const high = inb(kChannel0);
+        return static_cast<uint16_t>(low | (high << 8u));
     }
 
   private:
-};
\ No newline at end of file
+    static constexpr uint16_t kChannel0 = 0x40;
+    static constexpr uint16_t kCommand = 0x43;
+
+    static void writeCount(uint32_t count)
+    {
+        outb(kChannel0, static_cast<uint8_t>(count & 0xFFu));
+        outb(kChannel0, static_cast<uint8_t>(count >> 8u));
+    }
+};
+
+/** The PIT's channel 0, as the kernel's TimerDevice. The LAPIC timer isn't supported. */
+class PITTimerDevice final : public TimerDevice
+{
+  public:
+    [[nodiscard]] uint32_t cyclesPerTick() const override { return PIT::kBaseFrequency / PIT::kTickRate; }
+    [[nodiscard]] uint32_t maxOneShot() const override { return 0xFFFF; }
+
+    void startPeriodic() override { PIT::setFrequency(PIT::kTickRate); }
+    void startOneShot(uint32_t cycles) override { PIT::startOneShot(cycles); }
+    void stop() override { PIT::stop(); }
+
+    [[nodiscard]] uint32_t remaining() const override { return PIT::readPitCount(); }
+};
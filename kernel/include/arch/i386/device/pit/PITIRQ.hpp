@@ -27,6 +27,8 @@ class PITIRQ : public InterruptServiceRoutine
 
     virtual void operator()(RegisterTable &)
     {
+        // acknowledge first, as the tick may end in a switch to another process
         endOfInterrupt();
+        kernel->tick();
     }
 };
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mem/Units.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The kernel's half of the virtual address space.
+ *
+ * The kernel is linked at kKernelVirtualBase + its load address, and every
+ * address space maps the bottom kDirectMapSize bytes of physical memory
+ * linearly from kKernelVirtualBase up. Any frame in there, the kernel image
+ * included, can be reached by adding kKernelVirtualBase to its address, so
+ * page tables, fresh frames and I/O buffers need no temporary mappings.
+ *
+ *     0x00000000 - 0x00000FFF  never mapped, to catch null pointers
+ *     0x00001000 - 0xBFFFFFFF  user space, separate in every address space
+ *     0xC0000000 - 0xF7FFFFFF  direct map of physical memory below 896 MiB
+ *     0xF8000000 - 0xFFFFEFFF  kernel pages handed out by palloc()
+ *
+ * boot.s and linker.ld have their own copies of kKernelVirtualBase.
+ */
+namespace X86 {
+
+using namespace sys::mem_unit_literals;
+
+constexpr std::uintptr_t const kKernelVirtualBase = 0xC0000000;
+constexpr std::size_t const kDirectMapSize = 896_MiB;
+constexpr std::uintptr_t const kDirectMapEnd = kKernelVirtualBase + kDirectMapSize;
+
+constexpr std::uintptr_t const kUserSpaceStart = 0x1000;
+constexpr std::uintptr_t const kKernelPagesStart = kDirectMapEnd;
+constexpr std::uintptr_t const kKernelPagesEnd = 0xFFFFF000;
+
+/** How much physical memory boot.s maps before the MMU builds the real direct map. */
+constexpr std::size_t const kBootMapSize = 16_MiB;
+
+/** The direct map address of physical memory below kDirectMapSize. */
+template <typename T = void>
+T *physicalToVirtual(std::uintptr_t physicalAddress)
+{
+    return reinterpret_cast<T *>(physicalAddress + kKernelVirtualBase);
+}
+
+/** The physical address behind a direct map address, e.g. one in the kernel image. */
+inline std::uintptr_t virtualToPhysical(void const *virtualAddress)
+{
+    return reinterpret_cast<std::uintptr_t>(virtualAddress) - kKernelVirtualBase;
+}
+
+/** Whether a virtual address belongs to the kernel, and so is the same in every address space. */
+constexpr bool isKernelAddress(std::uintptr_t virtualAddress) { return virtualAddress >= kKernelVirtualBase; }
+
+} // namespace X86
@@ -4,31 +4,57 @@
 
 #pragma once
 
+#include <arch/i386/mem/DirectMap.hpp>
 #include <mem/AddressSpace.hpp>
+#include <mem/FrameCache.hpp>
 #include <mem/PageFrameAllocator.hpp>
+#include <mem/VirtualMemoryMap.hpp>
+#include <mem/VirtualRangeAllocator.hpp>
 
-/** Abstraction for the X86 memory management unit. Implements paging. */
+namespace X86 {
+class PageTableRange;
+}
+
+/** Options for page allocation. */
+enum PageAllocFlag : std::uint32_t
+{
+    kPageAllocNone = 0x0,
+    kPageAllocZeroed = 0x1, ///< The pages are cleared before they are returned.
+};
+
+/**
+ * Abstraction for the X86 memory management unit. Implements paging.
+ *
+ * The public operations run with interrupts disabled, so they may be used from
+ * interrupt handlers and are never preempted halfway through a table update.
+ */
 class MMU
 {
   public:
+    static constexpr std::size_t const kLargePageSize = 0x400000;
+
     MMU(uint32_t mmap_addr, uint32_t mmap_length);
 
     /**
-     * Allocates contiguous pages of memory.
+     * Allocates contiguous pages of kernel memory, which every address space
+     * sees at the same place.
      * @param addressSpace The address space to allocate within.
      * @param numberOfPages The number of pages to allocate.
+     * @param flags Allocation options.
      * @return the start of the contiguous allocated memory.
      */
-    void *palloc(AddressSpace addressSpace, size_t numberOfPages);
+    void *palloc(AddressSpace addressSpace, size_t numberOfPages, PageAllocFlag flags = kPageAllocNone);
 
     /**
      * Attempts to allocate a number of pages at the given address.
      * @param addressSpace The address space to allocate within.
      * @param virtualAddress The target address.
      * @param numberOfPages The number of pages to allocate.
+     * @param flags Allocation options.
      * @return the start of the contiguous allocated memory.
      */
-    void *palloc(AddressSpace addressSpace, void *virtualAddress, size_t numberOfPages);
+    void *palloc(AddressSpace addressSpace, void *virtualAddress, size_t numberOfPages,
+                 PageAllocFlag flags = kPageAllocNone);
 
     /**
      * Frees a page-aligned block of memory.
@@ -39,20 +65,186 @@ class MMU
      */
     int pfree(AddressSpace addressSpace, void *startOfMemoryRange, size_t numberOfPages = 1);
 
-    PageTable cloneDirectory(AddressSpace src);
+    /**
+     * Frees a block of memory, however it was allocated. Neighbouring areas
+     * may have been merged with it, so the length is always explicit.
+     * @param addressSpace The address space to free from.
+     * @param startOfArea The start of the block.
+     * @param numberOfPages The length of the block in pages.
+     * @return -1 if the block is not mapped, 0 otherwise.
+     */
+    int unmap(AddressSpace addressSpace, void *startOfArea, size_t numberOfPages);
+
+    /**
+     * Checks that a block of memory lies entirely within areas of an address
+     * space that all have the given flags.
+     * @param addressSpace The address space to look in.
+     * @param startOfMemoryRange The start of the block.
+     * @param numberOfPages The length of the block in pages.
+     * @param flags The VirtualMemoryMap::AreaFlag values every area must have.
+     */
+    bool isMapped(AddressSpace addressSpace, void *startOfMemoryRange, size_t numberOfPages, std::uint8_t flags);
+
+    /**
+     * Reserves an area of user space without backing it. Each page gets a
+     * frame the first time it is touched, filled from the area's data as far
+     * as that reaches and zeroed beyond it.
+     * @param addressSpace The address space to allocate within.
+     * @param area The area. Its start must be page aligned, and its data must stay valid until it is freed.
+     * @return the start of the reserved memory, or nullptr.
+     */
+    void *pallocLazy(AddressSpace addressSpace, VirtualMemoryMap::Area area);
+
+    /**
+     * Resolves a page fault, by backing a page reserved with pallocLazy() or
+     * copying a copy-on-write page.
+     * @param addressSpace The address space the fault happened in.
+     * @param faultAddress The faulting address (CR2).
+     * @param errorCode The error code the CPU pushed for the fault.
+     * @return true if the faulting access can be retried.
+     */
+    bool handlePageFault(AddressSpace addressSpace, std::uintptr_t faultAddress, std::uint32_t errorCode);
+
+    /**
+     * Allocates 4 MiB pages. Each is backed by physically contiguous memory and
+     * mapped by a single directory entry, which saves both TLB entries and page
+     * tables for large buffers. Without PSE this is an ordinary palloc().
+     * @param addressSpace The address space to allocate within.
+     * @param numberOfLargePages The number of 4 MiB pages to allocate.
+     * @return the start of the allocated memory, aligned to 4 MiB, or nullptr.
+     */
+    void *pallocLarge(AddressSpace addressSpace, size_t numberOfLargePages);
+
+    /**
+     * Frees memory allocated with pallocLarge().
+     * @param addressSpace The address space to free from.
+     * @param startOfMemoryRange The start of the memory block to free.
+     * @param numberOfLargePages The length of the memory block in 4 MiB pages.
+     * @return -1 if an error occurred, 0 otherwise.
+     */
+    int pfreeLarge(AddressSpace addressSpace, void *startOfMemoryRange, size_t numberOfLargePages);
+
+    /**
+     * Creates a copy-on-write clone of an address space. User page tables are
+     * copied, but the frames behind them are shared read-only by both spaces
+     * and only copied once either one writes to them, so this costs time in
+     * proportion to the page tables rather than to the memory in use. The
+     * kernel half is shared as it is.
+     * @param src The address space to clone.
+     * @return the new address space.
+     */
+    AddressSpace cloneDirectory(AddressSpace src);
+
+    /**
+     * Creates an empty address space, which shares the kernel half with the existing ones.
+     * @return the new address space, or one whose address() is nullptr if there are already
+     *         as many address spaces as the MMU can keep maps for.
+     */
+    AddressSpace create();
 
-    AddressSpace create() { return AddressSpace{(uint32_t *)(_pageFrameAllocator.alloc(1))}; }
+    /**
+     * Frees an address space made by create() or cloneDirectory(): the user
+     * pages only it maps, its page tables, its directory and its maps. It must
+     * not be the one in use.
+     */
+    void destroy(AddressSpace addressSpace);
 
-    /** Prepares and installs a page directory. */
+    /**
+     * Prepares and installs the kernel's page directory: maps physical memory
+     * below high memory at X86::kKernelVirtualBase, and leaves the rest empty.
+     * Until this runs, only what boot.s mapped is reachable.
+     */
     void install(AddressSpace addressSpace);
 
+    /**
+     * Clears one frame ahead of time for kPageAllocZeroed allocations. Meant to
+     * be called whenever the system is idle.
+     * @return false if the zeroed pool is full (or memory is short) and there was nothing to do.
+     */
+    bool prepareZeroedFrame();
+
   private:
+    static constexpr std::size_t const kZeroedPoolSize = 32;
+    static constexpr std::size_t const kMaxAddressSpaces = 8;
+
+    /**
+     * The free virtual ranges and the areas of user space in one address
+     * space, keyed by its page directory, or of the kernel's pages.
+     */
+    struct AddressSpaceMaps
+    {
+        std::uint32_t *directory = nullptr;
+        VirtualRangeAllocator ranges;
+        VirtualMemoryMap areas;
+    };
+
+    /** A frame for a new mapping, and whether it is known to be clear already. */
+    struct FreshFrame
+    {
+        PageFrame frame;
+        bool zeroed;
+    };
+
+    FreshFrame takeFrame(PageAllocFlag flags);
+
+    /**
+     * A frame for a page directory or table. Until install() has built the
+     * direct map, it comes from the part of memory boot.s mapped.
+     */
+    PageFrame takeTableFrame();
+
+    /** Resolves a write to a copy-on-write page. */
+    bool copyOnWrite(AddressSpace addressSpace, std::uintptr_t faultAddress);
+
+    /**
+     * Sets a page directory entry. Entries in the kernel half are set in every
+     * address space, so that they all keep seeing the same kernel.
+     */
+    void setDirectoryEntry(AddressSpace addressSpace, std::uint16_t directoryIndex, PageEntry entry);
+
+    /** The user space maps of an address space, set up on first use. */
+    AddressSpaceMaps &mapsFor(AddressSpace addressSpace);
+    AddressSpaceMaps &newMaps(AddressSpace addressSpace);
+
+    /** The maps covering an address: the kernel's, or the address space's user space ones. */
+    AddressSpaceMaps &mapsFor(AddressSpace addressSpace, std::uintptr_t address);
+
+    /**
+     * Takes a virtual range and records it as an area.
+     * @param maps The maps to take the range from.
+     * @param address The start of the range, or 0 to take the lowest free one.
+     * @param alignment The alignment of the range, in pages, if `address` is 0.
+     * @param area The area to record. Its start and end are filled in.
+     * @return the start of the range, or 0.
+     */
+    std::uintptr_t claimRange(AddressSpaceMaps &maps, std::uintptr_t address, std::size_t numberOfPages,
+                              std::size_t alignment, VirtualMemoryMap::Area area);
+
+    /**
+     * Gives a virtual range back and drops it from the areas.
+     * @return false if part of the range is not mapped, or if either map is too full to record the change.
+     *         Neither changes then.
+     */
+    bool releaseRange(AddressSpaceMaps &maps, std::uintptr_t address, std::size_t numberOfPages);
     PageTable getOrCreateTable(AddressSpace addressSpace, uint16_t directoryIndex);
-    PageTable tableForAddress(AddressSpace addressSpace, void *virtualAddress);
-    PageEntry pageForAddress(AddressSpace addressSpace, void *virtualAddress);
-    void allocatePages(AddressSpace addressSpace, void *address, size_t numberOfPages);
-    void _flush();
+
+    /** The page table entries covering a range of an address space, a table at a time. */
+    X86::PageTableRange tablesFor(AddressSpace addressSpace, std::uintptr_t address, std::size_t numberOfPages);
+
+    void allocatePages(AddressSpace addressSpace, void *address, size_t numberOfPages, PageAllocFlag flags);
+
+    /** The hot frame cache for the current CPU. */
+    FrameCache &frameCache() { return _frameCache; }
 
     PageFrameAllocator _pageFrameAllocator;
-    bool _pagingEnabled = false;
+    // Only the boot CPU is brought up, so there is just one. The MMU clears and
+    // copies frames through the direct map, so they can't come from high memory.
+    FrameCache _frameCache{_pageFrameAllocator, PageFrameAllocator::Zone::kNormal};
+    AddressSpaceMaps _addressSpaceMaps[kMaxAddressSpaces]{};
+    AddressSpaceMaps _kernelMaps{}; ///< The kernel's pages, above the direct map.
+    PageFrame _zeroedFrames[kZeroedPoolSize]{}; ///< Frames cleared during idle time.
+    std::size_t _zeroedCount = 0;
+    bool _largePages = false;  ///< Whether PSE is enabled.
+    bool _globalPages = false; ///< Whether PGE is enabled.
+    bool _directMapped = false; ///< Whether install() has built the direct map yet.
 };
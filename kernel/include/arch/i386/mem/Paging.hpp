@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <arch/i386/mem/DirectMap.hpp>
 #include <mem/PageTable.hpp>
 
 #include <mem/Units.hpp>
@@ -11,6 +12,8 @@
 #include <util/TypeTraits.hpp>
 #include <system/asm.h>
 
+#include <algorithm>
+
 namespace X86 {
 
 using namespace sys::mem_unit_literals;
@@ -124,4 +127,94 @@ class PageDirectory::PageProxy
 
 inline auto PageDirectory::operator[](Index idx) const -> PageProxy { return {tables_[idx.directory], idx.page}; }
 
+/**
+ * The page table entries covering a virtual range, one page table at a time.
+ *
+ * Iterating yields a Run for every directory entry the range touches: the
+ * slice of that entry's page table which lies in the range. Range operations
+ * look each directory entry up once and then go through its table directly,
+ * so they cost one lookup per table rather than one per page, and can skip
+ * whole tables that aren't there.
+ *
+ * The directory entry is read as the iterator reaches it, so a loop can
+ * create the table for one run without the next one seeing stale state.
+ */
+class PageTableRange
+{
+  public:
+    static constexpr std::uint32_t const kEntriesPerTable = 0x400;
+
+    /** The part of a range which lies under one directory entry. */
+    struct Run
+    {
+        std::uint16_t directoryIndex; ///< The directory entry this run is under.
+        std::uint16_t first;          ///< The first table entry in the range.
+        std::uint16_t end;            ///< One past the last table entry in the range.
+        PageEntry pde;                ///< The directory entry, as it was when the run was reached.
+
+        [[nodiscard]] bool present() const { return pde.getFlag(kPresentBit); }
+        [[nodiscard]] bool large() const { return pde.getFlag(kPageSizeBit); }
+
+        /** The page table. Only valid if the entry is present() and not large(). */
+        [[nodiscard]] PageTable table() const { return PageTable{physicalToVirtual(pde.address())}; }
+
+        /** The virtual address mapped by a table entry. */
+        [[nodiscard]] std::uintptr_t addressOf(std::uint16_t index) const
+        {
+            return (std::uintptr_t(directoryIndex) << 22u) | (std::uintptr_t(index) << 12u);
+        }
+    };
+
+    class Iterator
+    {
+      public:
+        Iterator(PageTable directory, std::uint32_t page, std::uint32_t endPage)
+            : _directory{directory}, _page{page}, _endPage{endPage}
+        {}
+
+        Run operator*() const
+        {
+            auto const directoryIndex = std::uint16_t(_page / kEntriesPerTable);
+            auto const tableEnd = std::min((std::uint32_t(directoryIndex) + 1) * kEntriesPerTable, _endPage);
+            return Run{.directoryIndex = directoryIndex,
+                       .first = std::uint16_t(_page % kEntriesPerTable),
+                       .end = std::uint16_t(tableEnd - std::uint32_t(directoryIndex) * kEntriesPerTable),
+                       .pde = _directory.entryAtIndex(directoryIndex)};
+        }
+
+        Iterator &operator++()
+        {
+            _page = std::min((_page / kEntriesPerTable + 1) * kEntriesPerTable, _endPage);
+            return *this;
+        }
+
+        bool operator==(Iterator const &other) const { return _page == other._page; }
+
+      private:
+        PageTable _directory;
+        std::uint32_t _page;
+        std::uint32_t _endPage;
+    };
+
+    /**
+     * @param directory The page directory, as reachable from the kernel.
+     * @param address The start of the range. Rounded down to a page.
+     * @param numberOfPages The length of the range, in pages.
+     */
+    PageTableRange(PageTable directory, std::uintptr_t address, std::size_t numberOfPages)
+        : _directory{directory}
+        , _firstPage{std::uint32_t(address / kPageFrameSize)}
+        , _endPage{std::uint32_t(std::min<std::uint64_t>(_firstPage + std::uint64_t(numberOfPages),
+                                                         std::uint64_t(kEntriesPerTable) * kEntriesPerTable))}
+    {}
+
+    [[nodiscard]] Iterator begin() const { return Iterator{_directory, _firstPage, _endPage}; }
+    [[nodiscard]] Iterator end() const { return Iterator{_directory, _endPage, _endPage}; }
+
+  private:
+    PageTable _directory;
+    std::uint32_t _firstPage;
+    std::uint32_t _endPage;
+};
+
 } //namespace X86
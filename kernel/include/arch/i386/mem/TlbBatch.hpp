@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Collects the virtual pages whose mappings changed during an operation, so
+ * the TLB can be brought up to date once at the end.
+ *
+ * Small batches are invalidated page by page with `invlpg`, which leaves every
+ * other translation cached. Past kMaxPages a single full flush is cheaper.
+ *
+ * Only mappings that were present need to be added: the CPU never caches a
+ * translation for a non-present page, so creating a mapping needs no
+ * invalidation.
+ *
+ * A CR3 reload keeps global pages cached. If a global mapping changed, a full
+ * flush also toggles CR4.PGE so that it is dropped as well.
+ */
+class TlbBatch
+{
+  public:
+    static constexpr std::size_t const kMaxPages = 32;
+
+    TlbBatch() = default;
+    TlbBatch(TlbBatch const &) = delete;
+    TlbBatch &operator=(TlbBatch const &) = delete;
+
+    /** Commits anything still pending. */
+    ~TlbBatch() { commit(); }
+
+    /**
+     * Adds a single changed page.
+     * @param virtualAddress The page whose mapping changed.
+     * @param global Whether the old mapping was global.
+     */
+    void add(std::uintptr_t virtualAddress, bool global = false)
+    {
+        _global = _global || global;
+        if (_count < kMaxPages) {
+            _pages[_count++] = virtualAddress;
+        } else {
+            _fullFlush = true;
+        }
+    }
+
+    /**
+     * Asks for the whole TLB to be flushed, e.g. when a page directory entry changed.
+     * @param global Whether global mappings were affected too.
+     */
+    void addAll(bool global = false)
+    {
+        _global = _global || global;
+        _fullFlush = true;
+    }
+
+    /** Invalidates everything collected so far and empties the batch. */
+    void commit();
+
+  private:
+    std::uintptr_t _pages[kMaxPages]{};
+    std::size_t _count = 0;
+    bool _fullFlush = false;
+    bool _global = false;
+};
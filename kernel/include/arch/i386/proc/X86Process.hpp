@@ -5,6 +5,7 @@
 #pragma once
 
 #include <arch/i386/cpu/RegisterTable.h>
+#include <mem/AddressSpace.hpp>
 #include <proc/Process.hpp>
 
 namespace X86Process {
@@ -26,6 +27,7 @@ struct State : Process::ICpuState
     RegisterTable trapFrame;               // Trap frame for current syscall
     Context *context;                      // context_switch() here to run process
     void *chan;                            // If non-zero, sleeping on chan
+    AddressSpace addressSpace;             // What the process's pgdir points to
 };
 
 } // namespace X86Process
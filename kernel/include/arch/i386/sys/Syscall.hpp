@@ -12,9 +12,14 @@ namespace Syscall {
     inline std::uint32_t write(X86Kernel &k, RegisterTable const &registers);
     inline std::uint32_t read(X86Kernel &k, RegisterTable const &registers);
     inline std::uint32_t exit(X86Kernel &, RegisterTable const &registers);
-    inline std::uint32_t sleep(X86Kernel &, RegisterTable const &registers);
+    inline std::uint32_t sleep(X86Kernel &k, RegisterTable const &registers);
+    inline std::uint32_t nanosleep(X86Kernel &k, RegisterTable const &registers);
     inline std::uint32_t yield(X86Kernel &, RegisterTable const &registers);
     inline std::uint32_t die(X86Kernel &, RegisterTable const &registers);
+    inline std::uint32_t sbrk(X86Kernel &k, RegisterTable const &registers);
+    inline std::uint32_t mmap(X86Kernel &k, RegisterTable const &registers);
+    inline std::uint32_t munmap(X86Kernel &k, RegisterTable const &registers);
+    inline std::uint32_t heapProfile(X86Kernel &k, RegisterTable const &registers);
 } // namespace Syscall
 
 struct SyscallHandler : public InterruptServiceRoutine
@@ -46,6 +51,16 @@ struct SyscallHandler : public InterruptServiceRoutine
                 registers.eax = Syscall::yield(_kernel, registers); break;
             case SyscallId::kDie:
                 registers.eax = Syscall::die(_kernel, registers); break;
+            case SyscallId::kSbrk:
+                registers.eax = Syscall::sbrk(_kernel, registers); break;
+            case SyscallId::kMmap:
+                registers.eax = Syscall::mmap(_kernel, registers); break;
+            case SyscallId::kMunmap:
+                registers.eax = Syscall::munmap(_kernel, registers); break;
+            case SyscallId::kNanosleep:
+                registers.eax = Syscall::nanosleep(_kernel, registers); break;
+            case SyscallId::kHeapProfile:
+                registers.eax = Syscall::heapProfile(_kernel, registers); break;
             default:
                 reportUnknownSyscall(registers);
         }
@@ -61,6 +76,7 @@ namespace Syscall {
 
 constexpr inline std::uint32_t kStdOut = 0;
 constexpr inline std::uint32_t kStdIn = 1;
+constexpr inline std::uint32_t kPageSize = 0x1000;
 
 inline std::uint32_t write(X86Kernel &k, RegisterTable const &registers)
 {
@@ -93,12 +109,88 @@ inline std::uint32_t exit(X86Kernel &k, RegisterTable const &registers)
     return registers.ebx;
 }
 
-inline std::uint32_t sleep(X86Kernel &, RegisterTable const &) { return 0; }
-inline std::uint32_t yield(X86Kernel &, RegisterTable const &) { return 0; }
+inline std::uint32_t sleep(X86Kernel &k, RegisterTable const &registers)
+{
+    auto const seconds = static_cast<std::int32_t>(registers.ebx);
+    if (seconds > 0) {
+        k.sleep(std::uint64_t(seconds) * 1'000'000'000);
+    }
+    return 0;
+}
+
+inline std::uint32_t nanosleep(X86Kernel &k, RegisterTable const &registers)
+{
+    auto const seconds = registers.ebx;
+    auto const nanoseconds = registers.ecx;
+    if (nanoseconds >= 1'000'000'000) {
+        return static_cast<std::uint32_t>(-1);
+    }
+
+    k.sleep(std::uint64_t(seconds) * 1'000'000'000 + nanoseconds);
+    return 0;
+}
+inline std::uint32_t yield(X86Kernel &k, RegisterTable const &)
+{
+    // the switch happens on the way out of the syscall
+    k.scheduler().yield();
+    return 0;
+}
 inline std::uint32_t die(X86Kernel &, RegisterTable const &)
 {
     kernel->panic("Committed honorable sudoku");
     return 0;
 }
 
+inline std::uint32_t sbrk(X86Kernel &k, RegisterTable const &registers)
+{
+    auto *heap = k.heap();
+    if (!heap) {
+        return static_cast<std::uint32_t>(-1);
+    }
+
+    return heap->grow(static_cast<std::int32_t>(registers.ebx));
+}
+
+inline std::uint32_t mmap(X86Kernel &k, RegisterTable const &registers)
+{
+    auto const address = registers.ebx;
+    auto const length = registers.ecx;
+    if (length == 0 || (address & (kPageSize - 1)) || length > UINT32_MAX - address - (kPageSize - 1)) {
+        return static_cast<std::uint32_t>(-1);
+    }
+
+    // a null address lets the MMU pick where the area goes
+    VirtualMemoryMap::Area area{.start = address,
+                                .end = address + ((length + kPageSize - 1) & ~(kPageSize - 1)),
+                                .protection = VirtualMemoryMap::kProtRead | VirtualMemoryMap::kProtWrite,
+                                .flags = VirtualMemoryMap::kAreaMapped};
+    auto *memory = k.pallocLazy(area);
+    return memory ? reinterpret_cast<std::uint32_t>(memory) : static_cast<std::uint32_t>(-1);
+}
+
+inline std::uint32_t munmap(X86Kernel &k, RegisterTable const &registers)
+{
+    auto const address = registers.ebx;
+    auto const length = registers.ecx;
+    if (length == 0 || (address & (kPageSize - 1)) || address >= X86::kKernelVirtualBase
+        || length > X86::kKernelVirtualBase - address) {
+        return static_cast<std::uint32_t>(-1); // the kernel's memory is off limits
+    }
+
+    // the heap and the executable's segments belong to the kernel, which frees them itself
+    auto *start = reinterpret_cast<void *>(address);
+    auto const pages = (length + kPageSize - 1) / kPageSize;
+    if (!k.isMapped(start, pages, VirtualMemoryMap::kAreaMapped)) {
+        return static_cast<std::uint32_t>(-1);
+    }
+
+    return static_cast<std::uint32_t>(k.pfree(start, pages));
+}
+
+inline std::uint32_t heapProfile(X86Kernel &k, RegisterTable const &)
+{
+    k.dumpHeapProfile();
+    return 0;
+}
+
 } // namespace Syscall
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <system/asm.h>
+
+#include <cstdint>
+
+/**
+ * Keeps interrupts disabled for as long as it lives, then puts the interrupt
+ * flag back the way it was, so guards can nest. With a single CPU, that's all
+ * it takes to make a section safe from interrupt handlers.
+ */
+class InterruptGuard
+{
+  public:
+    InterruptGuard() : _flags{irq_save()} {}
+    ~InterruptGuard() { irq_restore(_flags); }
+
+    InterruptGuard(InterruptGuard const &) = delete;
+    InterruptGuard &operator=(InterruptGuard const &) = delete;
+
+  private:
+    std::uint32_t _flags;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <arch/i386/mem/DirectMap.hpp>
+
 #include <cstddef>
 #include <cstdint>
 #include "Console.hpp"
@@ -84,5 +86,5 @@ class VGATextConsole : public Console
     std::size_t _consoleRow = 0;
     std::size_t _consoleColumn = 0;
     std::uint8_t _consoleColor = kDefaultTextColor | kDefaultBackgroundColor << 4u;
-    std::uint16_t *_consoleBuffer = (uint16_t *)0xB8000;
+    std::uint16_t *_consoleBuffer = X86::physicalToVirtual<std::uint16_t>(0xB8000);
 };
@@ -8,11 +8,17 @@
 #include <device/input/Keyboard.hpp>
 #include <util/RingBuffer.hpp>
 
+class Process;
+
 class PS2Keyboard : public Keyboard
 {
 public:
     PS2Keyboard();
 
+    /**
+     * Takes the next key event. If none is buffered, a process sleeps until
+     * the ISR brings one in; code that can't be switched away from halts.
+     */
     virtual KeyEvent read();
 
     virtual bool keyIsPressed(KeyCode key) const { return _keysPressed[key]; }
@@ -21,7 +27,9 @@ public:
 
 private:
     void pushScanCode(uint8_t code);
+    void waitForScanCode();
 
     sys::RingBuffer<int> _buffer;
     bool _keysPressed[256];
+    Process *_reader{nullptr}; ///< The process asleep in read(), if any.
 };
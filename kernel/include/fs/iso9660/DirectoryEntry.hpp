@@ -2,13 +2,14 @@
 
 #include <fs/DirectoryEntry.hpp>
 #include <fs/iso9660/DataStructures.hpp>
+#include <mem/SlabCache.hpp>
 #include <util/StringTokenizer.hpp>
 
 namespace iso9660 {
 
 class Volume;
 
-class DirectoryEntry : public ::DirectoryEntry
+class DirectoryEntry : public ::DirectoryEntry, public SlabAllocated<DirectoryEntry>
 {
   public:
     DirectoryEntry(DirectoryInfo &info, Volume &volume);
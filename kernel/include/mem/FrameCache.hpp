@@ -0,0 +1,63 @@
+#pragma once
+
+#include <mem/PageFrameAllocator.hpp>
+
+#include <cstddef>
+
+/**
+ * A small LIFO "magazine" of single page frames sitting in front of a
+ * PageFrameAllocator.
+ *
+ * Single-frame allocations and frees are served from the magazine, which is
+ * refilled from (and drained back to) the allocator in batches. Recently freed
+ * frames are reused first, while they are still warm in the cache.
+ *
+ * A FrameCache holds no global state, so each CPU can own one. Frames sitting
+ * in a cache are accounted as used by the backing allocator.
+ */
+class FrameCache
+{
+  public:
+    static constexpr std::size_t const kCapacity = 64; ///< Most frames held at once.
+    static constexpr std::size_t const kBatch = 16;    ///< Frames moved per refill or drain.
+
+    /**
+     * @param backing The allocator to refill from and drain to.
+     * @param zone The zone to take frames from.
+     */
+    explicit FrameCache(PageFrameAllocator &backing, PageFrameAllocator::Zone zone = PageFrameAllocator::Zone::kNormal)
+        : _backing{&backing}, _zone{zone}
+    {}
+
+    FrameCache(FrameCache const &) = delete;
+    FrameCache &operator=(FrameCache const &) = delete;
+
+    /** Allocates a single frame. Panics if physical memory is exhausted. */
+    PageFrame alloc()
+    {
+        if (_count == 0) { refill(); }
+        return _frames[--_count];
+    }
+
+    /** Frees a single frame. */
+    void free(PageFrame frame)
+    {
+        if (_count == kCapacity) { drain(); }
+        _frames[_count++] = frame;
+    }
+
+    /** Returns every cached frame to the backing allocator. */
+    void flush();
+
+    /** The number of frames currently cached. */
+    [[nodiscard]] std::size_t size() const { return _count; }
+
+  private:
+    void refill();
+    void drain();
+
+    PageFrameAllocator *_backing;
+    PageFrameAllocator::Zone _zone;
+    PageFrame _frames[kCapacity]{};
+    std::size_t _count = 0;
+};
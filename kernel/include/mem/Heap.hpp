@@ -7,19 +7,34 @@
 #include <cstddef>
 #include <cstdint>
 
-/** A process's free store (heap memory). */
+/**
+ * A process's free store (heap memory).
+ *
+ * The heap is backed a page at a time: the pages between the end of the heap
+ * and the next page boundary are already there, so small changes never touch
+ * the MMU. New pages are demand paged, so they only cost memory once used.
+ */
 class Heap
 {
   public:
-    constexpr explicit Heap(std::uintptr_t begin) noexcept : _begin(begin), _end(begin) {}
+    /**
+     * @param begin Where the heap starts.
+     * @param limit The address the heap must not grow past.
+     */
+    constexpr explicit Heap(std::uintptr_t begin, std::uintptr_t limit = UINTPTR_MAX) noexcept
+        : _begin(begin), _end(begin), _alignedEnd(pageAlign(begin)), _limit(limit)
+    {}
 
     /**
-     * Grows the heap by the given amount.
+     * Grows, or with a negative increment shrinks, the heap by the given amount.
      * This provides the functional equivalent of `sbrk()`.
-     * @param size The amount to grow the heap by.
+     * @param increment The amount to grow the heap by, in bytes.
      * @return The previous end of the heap, or UINTPTR_MAX (-1) on error.
      */
-    std::uintptr_t grow(std::uintptr_t size) noexcept;
+    std::uintptr_t grow(std::ptrdiff_t increment) noexcept;
+
+    /** Shrinks the heap to nothing, giving all of its pages back. */
+    void release() noexcept { grow(-size()); }
 
     /** The begin address of the heap. */
     [[nodiscard]] constexpr std::uintptr_t begin() const noexcept { return _begin; }
@@ -31,6 +46,8 @@ class Heap
     [[nodiscard]] constexpr std::ptrdiff_t size() const noexcept { return static_cast<std::ptrdiff_t>(_end - _begin); }
 
   private:
+    static constexpr std::uintptr_t pageAlign(std::uintptr_t address) { return (address + 0xFFF) & ~std::uintptr_t{0xFFF}; }
+
     std::uintptr_t _begin = UINTPTR_MAX; ///< Beginning of the heap.
     std::uintptr_t _end = 0;             ///< End of the heap. (unaligned)
     std::uintptr_t _alignedEnd = 0;      ///< _end rounded up to nearest page boundary.
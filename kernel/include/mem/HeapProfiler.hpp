@@ -0,0 +1,90 @@
+#pragma once
+
+#include <io/OutputStream.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Records where kernel heap memory goes, in builds configured with
+ * LAMBOS_HEAP_PROFILER.
+ *
+ * Every allocation is charged to the return address of its caller, so each
+ * call site gets counts of allocations and frees, its live bytes and their
+ * high-water mark. Sizes go into a power-of-two histogram. Blocks are tracked
+ * until freed in a fixed-size hash table, so nothing here allocates.
+ *
+ * dump() writes it all out as `HEAPPROF` lines, which
+ * scripts/heap_profile_report.py symbolises and aggregates.
+ */
+class HeapProfiler
+{
+  public:
+    static constexpr std::size_t const kMaxSites = 512;
+    static constexpr std::size_t const kMaxLiveBlocks = 8192;
+    static constexpr std::size_t const kHistogramBuckets = 14; ///< 16 bytes, 32 bytes, ... 64 KiB and bigger.
+
+    /** The profiler the allocators report to. */
+    static HeapProfiler &instance();
+
+    /** Records a new block. A null block (a failed allocation) is only counted. */
+    void recordAllocation(void const *block, std::size_t size, void const *caller);
+
+    /** Records that a block was freed. */
+    void recordFree(void const *block);
+
+    /** Writes the counters, histogram and call sites out, one `HEAPPROF` line each. */
+    void dump(sys::OutputStream &out) const;
+
+  private:
+    struct Site
+    {
+        void const *caller = nullptr;
+        std::uint32_t allocations = 0;
+        std::uint32_t frees = 0;
+        std::size_t liveBytes = 0;
+        std::size_t peakBytes = 0;
+        std::size_t totalBytes = 0;
+    };
+
+    struct LiveBlock
+    {
+        void const *block = nullptr;
+        std::size_t size = 0;
+        std::uint16_t site = 0;
+    };
+
+    static std::size_t hash(void const *pointer, std::size_t capacity);
+    static std::size_t bucketFor(std::size_t size);
+
+    /** The site for a caller, or nullptr if the table is full. */
+    Site *siteFor(void const *caller);
+
+    Site _sites[kMaxSites]{};
+    LiveBlock _liveBlocks[kMaxLiveBlocks]{};
+    std::uint32_t _histogram[kHistogramBuckets]{};
+    std::uint32_t _allocations = 0;
+    std::uint32_t _frees = 0;
+    std::uint32_t _failures = 0;
+    std::uint32_t _untracked = 0; ///< Allocations made while a table was full.
+    std::size_t _liveBlockCount = 0;
+    std::size_t _liveBytes = 0;
+    std::size_t _peakBytes = 0;
+};
+
+/** Reports an allocation to the profiler, if this build has one. */
+inline void profileAllocation([[maybe_unused]] void const *block, [[maybe_unused]] std::size_t size,
+                              [[maybe_unused]] void const *caller)
+{
+#ifdef LAMBOS_HEAP_PROFILER
+    HeapProfiler::instance().recordAllocation(block, size, caller);
+#endif
+}
+
+/** Reports a free to the profiler, if this build has one. */
+inline void profileFree([[maybe_unused]] void const *block)
+{
+#ifdef LAMBOS_HEAP_PROFILER
+    if (block) { HeapProfiler::instance().recordFree(block); }
+#endif
+}
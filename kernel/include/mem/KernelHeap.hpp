@@ -0,0 +1,111 @@
+#pragma once
+
+#include <mem/SlabCache.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * The kernel's malloc, behind kmalloc(), krealloc(), kcalloc() and kfree().
+ *
+ * Small requests are rounded up to one of a set of size classes, powers of two
+ * with one class between each pair to bound the waste to a third, and served
+ * from a SlabCache per class. Finding the class is a table lookup and the
+ * caches are O(1), so small allocations take bounded time no matter how
+ * fragmented the heap is.
+ *
+ * Each class's cache aligns its objects to the largest power of two dividing
+ * the class size, which costs no space in a page-sized slab. Rounding an
+ * aligned request up to a multiple of its alignment then always lands in a
+ * class that is aligned enough, so kmemalign() is just as cheap.
+ *
+ * Anything bigger than the largest class gets pages of its own from palloc(),
+ * with a header at the start of the first page recording how many. The header
+ * starts with a null pointer where a slab keeps its cache, which is how kfree()
+ * tells the two apart. A page-aligned block has its header in the page before
+ * it, since neither slab objects nor other blocks ever start on a page boundary.
+ *
+ * All operations may be used from interrupt handlers: the heap, the slab caches
+ * and the MMU operations beneath them all run with interrupts disabled.
+ *
+ * In builds with LAMBOS_HEAP_PROFILER, kmalloc() and friends report to the
+ * HeapProfiler, charging each block to their caller.
+ */
+class KernelHeap
+{
+  public:
+    constexpr KernelHeap() = default;
+
+    KernelHeap(KernelHeap const &) = delete;
+    KernelHeap &operator=(KernelHeap const &) = delete;
+
+    /** The heap behind kmalloc(). */
+    static KernelHeap &instance();
+
+    /** Allocates `size` bytes, aligned to 16. Returns nullptr if memory runs out. */
+    void *allocate(std::size_t size);
+
+    /**
+     * Allocates `size` bytes aligned to `alignment`, which must be a power of
+     * two no bigger than a page.
+     * @return The block, or nullptr if memory runs out or the alignment isn't supported.
+     */
+    void *allocateAligned(std::size_t alignment, std::size_t size);
+
+    /** Resizes a block, moving it if it has to grow past what it can hold. The new block is only aligned to 16. */
+    void *reallocate(void *block, std::size_t size);
+
+    /** Allocates a zeroed array, or returns nullptr if its size overflows. */
+    void *allocateZeroed(std::size_t count, std::size_t size);
+
+    /** Frees a block. Freeing nullptr does nothing. */
+    void free(void *block);
+
+    /** Gives the pages of empty slabs back to the page allocator. */
+    void shrink();
+
+    /** Writes `HEAPPROF CLASS` lines for the size classes and a `HEAPPROF LARGE` line, for the heap profile. */
+    void report(sys::OutputStream &out) const;
+
+  private:
+    static constexpr std::size_t const kAlignment = 16;
+    static constexpr std::size_t const kSizeClasses = 12;
+    static constexpr std::size_t const kMaxSmallSize = SlabCache::kMaxObjectSize;
+    static constexpr std::size_t const kPageSize = 0x1000;
+
+    /** Starts the first page of a large block. */
+    struct alignas(kAlignment) LargeHeader
+    {
+        SlabCache *cache; ///< Always nullptr, where a slab has its cache.
+        std::size_t pages;
+    };
+
+    static bool isPageAligned(void *block) { return (reinterpret_cast<std::uintptr_t>(block) & (kPageSize - 1)) == 0; }
+
+    /** The header of a large block. */
+    static LargeHeader *headerOf(void *block);
+
+    /** The index of the size class holding `size` bytes, which is at most kMaxSmallSize. */
+    static std::size_t sizeClass(std::size_t size);
+
+    /** The number of bytes a block can hold. */
+    static std::size_t usableSize(void *block);
+
+    void *allocateLarge(std::size_t size, std::size_t alignment = kAlignment);
+    void freeLarge(LargeHeader *header);
+
+    /** The cache for a class size, aligned to the largest power of two dividing it. */
+    static constexpr SlabCache cacheFor(char const *name, std::size_t classSize)
+    {
+        return SlabCache{name, classSize, classSize & -classSize};
+    }
+
+    SlabCache _caches[kSizeClasses]{
+        cacheFor("kmalloc-16", 16),   cacheFor("kmalloc-32", 32),   cacheFor("kmalloc-48", 48),
+        cacheFor("kmalloc-64", 64),   cacheFor("kmalloc-96", 96),   cacheFor("kmalloc-128", 128),
+        cacheFor("kmalloc-192", 192), cacheFor("kmalloc-256", 256), cacheFor("kmalloc-384", 384),
+        cacheFor("kmalloc-512", 512), cacheFor("kmalloc-768", 768), cacheFor("kmalloc-1024", 1024)};
+
+    std::size_t _largeBlocks = 0;
+    std::size_t _largePages = 0;
+};
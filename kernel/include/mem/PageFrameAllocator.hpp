@@ -9,27 +9,85 @@
 
 #include <util/BitSet.hpp>
 
+#include <limits>
+
 constexpr std::uint32_t const kPagesInBitmap = 1048576;
 constexpr std::uint32_t const kFrameSize = 4096;
 
 using PageFrame = std::uintptr_t;
 
+/** Returned by allocation functions that can fail. Never a valid frame, as it isn't aligned. */
+constexpr PageFrame const kNoFrame = std::numeric_limits<PageFrame>::max();
+
+/**
+ * Physical page frame allocator.
+ *
+ * Free memory is managed as a binary buddy system: every free run of frames is
+ * split into naturally aligned power-of-two blocks, and each block sits on the
+ * free list for its order (log2 of its length in frames). Allocating takes the
+ * smallest block that fits and splits it down; freeing merges a block with its
+ * buddy for as long as the buddy is also free. Both are O(log n) in the number
+ * of frames.
+ *
+ * The free lists are threaded through an array of per-frame descriptors which
+ * is carved out of physical memory directly behind the kernel image when the
+ * memory map is loaded.
+ *
+ * Physical memory is split into zones, each with its own free lists. An
+ * allocation names the zone it would like, and falls back to lower zones
+ * only while they stay above their watermark, so that memory only a DMA
+ * capable device can reach isn't eaten up by ordinary allocations.
+ */
 class PageFrameAllocator
 {
   public:
-    struct Bitmap
+    /** Largest block order. An order 20 block spans the full 4 GiB. */
+    static constexpr std::uint32_t const kMaxOrder = 20;
+
+    /** Physical memory zones, in fallback order from highest to lowest. */
+    enum class Zone : std::uint8_t
+    {
+        kDMA,    ///< Below 16 MiB, reachable by ISA DMA.
+        kNormal, ///< 16 MiB to 896 MiB.
+        kHigh,   ///< Everything above.
+    };
+    static constexpr std::size_t const kZoneCount = 3;
+
+    /**
+     * Frame accounting. Every frame below the highest usable one is in exactly
+     * one of these states, and the counts are kept exact on each transition.
+     */
+    struct Usage
+    {
+        std::size_t freeFrames = 0;     ///< On the free lists.
+        std::size_t usedFrames = 0;     ///< Handed out by alloc() or requestFrame().
+        std::size_t reservedFrames = 0; ///< Holes in the memory map and frames marked unusable.
+    };
+
+    /** Bookkeeping for a single physical frame. */
+    struct FrameDescriptor
     {
-        void loadMemoryMap(uint32_t mmapAddr, uint32_t mmapLength);
-        bool usableAndFree(uint32_t frameIndex) { return usable[frameIndex] && !used[frameIndex]; }
+        static constexpr std::uint32_t const kNone = 0xFFFFFFFF;
+        static constexpr std::uint8_t const kFreeHead = 0x1; ///< Frame is the first frame of a free block.
+        static constexpr std::uint8_t const kReserved = 0x2; ///< Frame may never be handed out.
 
-        sys::BitSet<kPagesInBitmap> usable;
-        sys::BitSet<kPagesInBitmap> used;
+        std::uint32_t next;  ///< Next free block of the same order (frame index), if kFreeHead.
+        std::uint32_t prev;  ///< Previous free block of the same order (frame index), if kFreeHead.
+        std::uint8_t order;  ///< Order of the free block this frame heads, if kFreeHead.
+        std::uint8_t flags;
+        std::uint16_t shares; ///< Mappings of an allocated frame beyond the first (copy on write).
     };
 
     PageFrameAllocator() = default;
-    PageFrameAllocator(uint32_t mmapAddr, uint32_t mmapLength) { _bitmap.loadMemoryMap(mmapAddr, mmapLength); }
+    PageFrameAllocator(uint32_t mmapAddr, uint32_t mmapLength) { loadMemoryMap(mmapAddr, mmapLength); }
 
-    void loadMemoryMap(uint32_t mmapAddr, uint32_t mmapLength) { _bitmap.loadMemoryMap(mmapAddr, mmapLength); }
+    /**
+     * Reads the multiboot memory map, places the frame descriptors behind the
+     * kernel image and hands every usable frame to the buddy free lists.
+     * @param mmapPhysicalAddr The physical address of the multiboot memory map.
+     * @param mmapLength The length of the multiboot memory map, in bytes.
+     */
+    void loadMemoryMap(uint32_t mmapPhysicalAddr, uint32_t mmapLength);
 
     template <typename T>
     void * alloc()
@@ -38,13 +96,126 @@ class PageFrameAllocator
         return reinterpret_cast<void *>(alloc(framesNeeded));
     }
 
-    PageFrame alloc(std::size_t numberOfFrames);
+    /**
+     * Allocates physically contiguous frames.
+     * @param numberOfFrames The number of frames to allocate.
+     * @param zone The zone to allocate from. Lower zones are used once it runs out.
+     * @return The first frame. Panics if no zone can satisfy the request.
+     */
+    PageFrame alloc(std::size_t numberOfFrames, Zone zone = Zone::kNormal);
+
+    /** Like alloc(), but returns kNoFrame instead of panicking if memory runs out. */
+    PageFrame tryAlloc(std::size_t numberOfFrames, Zone zone = Zone::kNormal);
     void free(PageFrame frame, std::size_t numberOfFrames = 1);
+
+    /**
+     * Allocates up to `count` single frames, taking them a block at a time.
+     * Unlike alloc(), running out of memory is not fatal, and lower zones are
+     * never drawn below their watermark.
+     * @param frames Receives the allocated frames.
+     * @param count The number of frames wanted.
+     * @param zone The zone to allocate from.
+     * @return The number of frames actually allocated.
+     */
+    std::size_t allocBatch(PageFrame *frames, std::size_t count, Zone zone = Zone::kNormal);
+
+    /** Frees `count` single frames, as allocated by allocBatch(). */
+    void freeBatch(PageFrame const *frames, std::size_t count);
+
+    /**
+     * Records that one more mapping shares an allocated frame.
+     * @param frame The frame, or the first frame of a block.
+     */
+    void addReference(PageFrame frame);
+
+    /**
+     * Drops one mapping's reference to an allocated frame.
+     * @param frame The frame, or the first frame of a block.
+     * @return true if that was the last reference, and the caller should free the frame.
+     */
+    bool releaseReference(PageFrame frame);
+
+    /** Whether more than one mapping refers to an allocated frame. */
+    [[nodiscard]] bool isShared(PageFrame frame) const;
+
     void markFrameUsable(PageFrame frame, bool usable);
     bool requestFrame(PageFrame frame);
     bool requestFrameIndex(std::size_t index);
 
+    /**
+     * The first physical address past the kernel image and the allocator's own
+     * bookkeeping. Everything below it must stay mapped.
+     */
+    [[nodiscard]] PageFrame bootstrapEnd() const { return _bootstrapEnd; }
+
+    /** The physical address past the highest usable frame. */
+    [[nodiscard]] std::uint64_t memoryEnd() const { return std::uint64_t(_frameCount) * kFrameSize; }
+
+    /** Current frame accounting. O(1). */
+    [[nodiscard]] Usage const &usage() const { return _usage; }
+
+    /** The number of frames that can currently be allocated. O(1). */
+    [[nodiscard]] std::size_t freeFrames() const { return _usage.freeFrames; }
+
+    /** The number of free frames in a zone. O(1). */
+    [[nodiscard]] std::size_t freeFrames(Zone zone) const { return zoneState(zone).freeFrames; }
+
+    /** The number of frames in a zone held back from allocations that fell back to it. */
+    [[nodiscard]] std::size_t watermark(Zone zone) const { return zoneState(zone).watermark; }
+
+    /** The zone a frame belongs to. */
+    static Zone zoneOf(PageFrame frame);
+
   private:
-    Bitmap _bitmap{};
-    PageFrame _lastAllocFrame{0};
+    /** Free lists and accounting for one zone. */
+    struct ZoneState
+    {
+        std::uint32_t freeHeads[kMaxOrder + 1]{};
+        std::uint32_t nonEmptyOrders = 0; ///< Bit n is set if the order n free list is non-empty.
+        std::size_t freeFrames = 0;
+        std::size_t watermark = 0;
+    };
+
+    ZoneState &zoneState(Zone zone) { return _zones[std::size_t(zone)]; }
+    [[nodiscard]] ZoneState const &zoneState(Zone zone) const { return _zones[std::size_t(zone)]; }
+    ZoneState &zoneForIndex(std::uint32_t index);
+
+    /**
+     * Finds the first zone, starting at `zone` and falling back to lower ones,
+     * with a free block of at least the given order.
+     * @param honourWatermarks If set, lower zones are skipped if the block would
+     *                         take them below their watermark.
+     * @return The zone, or nullptr if there is none.
+     */
+    ZoneState *findZone(Zone zone, std::uint32_t order, bool honourWatermarks);
+
+    /** Allocates `count` frames from a block of the given order in `zone`. */
+    std::uint32_t takeFrames(ZoneState &zone, std::uint32_t order, std::uint32_t count);
+
+    [[nodiscard]] bool isFreeHead(std::uint32_t index, std::uint32_t order) const;
+    void pushFree(std::uint32_t index, std::uint32_t order);
+    void unlinkFree(std::uint32_t index, std::uint32_t order);
+    std::uint32_t popFree(ZoneState &zone, std::uint32_t order);
+
+    /** Returns a block to the free lists, merging it with its buddies. */
+    void freeBlock(std::uint32_t index, std::uint32_t order);
+
+    /** Returns an arbitrary run of frames to the free lists, keeping blocks within their zone. */
+    void freeRun(std::uint32_t index, std::uint32_t count);
+
+    /** Pulls a single frame out of whichever free block currently holds it. */
+    bool carveFrame(std::uint32_t index);
+
+    [[nodiscard]] bool isReserved(std::uint32_t index) const
+    {
+        return index >= _frameCount || (_frames && (_frames[index].flags & FrameDescriptor::kReserved));
+    }
+
+    /** Bit n is set if frame n is free. This is the single availability index for all frames. */
+    sys::BitSet<kPagesInBitmap> _free{};
+    Usage _usage{};
+    FrameDescriptor *_frames = nullptr;
+    std::uint32_t _frameCount = 0;
+    ZoneState _zones[kZoneCount]{};
+    PageFrame _bootstrapEnd = 0;
 };
@@ -13,16 +13,17 @@ constexpr std::uint32_t k4KPageAddressMask = 0xFFFFF000;
 constexpr std::uint32_t k4MPageAddressMask = 0xFFC00000;
 constexpr std::uint32_t kPageFlagsMask = 0x00000FFF;
 
-enum PageEntryFlag : std::uint8_t {
-    kPresentBit       = 0b00000001,
-    kReadWriteBit     = 0b00000010,
-    kSupervisorBit    = 0b00000100,
-    kWriteThroughBit  = 0b00001000,
-    kCacheDisabledBit = 0b00010000,
-    kAccessedBit      = 0b00100000,
-    kDirtyBit         = 0b01000000,
-    kPageSizeBit      = kDirtyBit,
-    kGlobalBit        = 0b10000000,
+enum PageEntryFlag : std::uint16_t {
+    kPresentBit       = 0b000000001,
+    kReadWriteBit     = 0b000000010,
+    kSupervisorBit    = 0b000000100,
+    kWriteThroughBit  = 0b000001000,
+    kCacheDisabledBit = 0b000010000,
+    kAccessedBit      = 0b000100000,
+    kDirtyBit         = 0b001000000,
+    kPageSizeBit      = 0b010000000, ///< Directory entries only: maps a 4 MiB page.
+    kGlobalBit        = 0b100000000,
+    kCopyOnWriteBit   = 0b1000000000, ///< Available to software: read-only until written, then copied.
 };
 
 constexpr PageEntryFlag operator~(PageEntryFlag flag)
@@ -40,7 +41,7 @@ class PageEntry
     PageEntry(std::uintptr_t entry, int) : entry_(entry) {}
 
     [[nodiscard]] bool getFlag(PageEntryFlag flag) const noexcept { return static_cast<bool>(entry_ & flag); }
-    void unsetFlag(PageEntryFlag flag) noexcept { entry_ &= ~flag; }
+    void unsetFlag(PageEntryFlag flag) noexcept { entry_ &= ~std::uintptr_t(flag); }
     void setFlag(PageEntryFlag flag) noexcept { entry_ |= flag; }
     void setFlags(std::uintptr_t flags) noexcept { entry_ = (entry_ & k4KPageAddressMask) | (flags & kPageFlagsMask); }
 
@@ -88,14 +89,12 @@ class PageTable
 
     /**
      * Sets the PageEntry at the given index.
+     * This doesn't touch the TLB. If the entry replaces a present mapping, the
+     * caller has to invalidate that page (see TlbBatch).
      * @param index The index to set/replace.
      * @param entry The entry to set.
      */
-    void setEntry(uint16_t index, PageEntry entry)
-    {
-        _tableAddress[index] = entry;
-        invalidatePage(entry.address());
-    }
+    void setEntry(uint16_t index, PageEntry entry) { _tableAddress[index] = entry; }
 
     /** Installs the PageTable as the active page directory. */
     void install();
@@ -103,6 +102,5 @@ class PageTable
     explicit operator bool() const { return _tableAddress != nullptr; }
 
   private:
-    static void invalidatePage(uintptr_t m);
     PageEntry *_tableAddress;
 };
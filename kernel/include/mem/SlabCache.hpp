@@ -0,0 +1,237 @@
+#pragma once
+
+#include <io/OutputStream.hpp>
+#include <mem/HeapProfiler.hpp>
+#include <mem/ObjectAllocator.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+/**
+ * A cache of fixed-size kernel objects, after Bonwick's slab allocator.
+ *
+ * Objects are carved out of slabs, each a single page from the page
+ * allocator with a small header at its start, so the slab an object belongs
+ * to is found by masking the object's address. Each slab threads a free list
+ * through its free objects, and the cache keeps its slabs on three lists
+ * (partially used, full and empty), so allocating and freeing are O(1) and
+ * objects of one kind are packed together.
+ *
+ * If the cache has a constructor, objects are constructed once, when their
+ * slab is created, and have to be handed back in their constructed state, so
+ * alloc() doesn't construct them again. The free list link is then kept
+ * behind the object instead of in it. Slabs are given back without
+ * destroying their objects, so constructed state must not own anything.
+ *
+ * A cache may be used from interrupt handlers: alloc(), free() and shrink()
+ * run with interrupts disabled.
+ */
+class SlabCache
+{
+  public:
+    using Constructor = void (*)(void *object);
+
+    static constexpr std::size_t const kSlabSize = 0x1000;
+
+    /** The largest object a cache takes. Anything bigger belongs on the heap. */
+    static constexpr std::size_t const kMaxObjectSize = 1024;
+
+    /**
+     * @param name A name for debugging.
+     * @param objectSize The size of the objects, at most kMaxObjectSize.
+     * @param alignment The alignment of the objects. Must be a power of two.
+     * @param constructor Prepares new objects, or nullptr.
+     */
+    constexpr SlabCache(char const *name, std::size_t objectSize, std::size_t alignment = alignof(std::max_align_t),
+                        Constructor constructor = nullptr)
+        : _name{name}
+        , _objectSize{objectSize}
+        , _linkOffset{constructor ? roundUp(objectSize, alignof(void *)) : 0}
+        , _stride{roundUp(constructor ? _linkOffset + sizeof(void *) : max(objectSize, sizeof(void *)),
+                          max(alignment, alignof(void *)))}
+        , _firstObject{roundUp(sizeof(Slab), max(alignment, alignof(void *)))}
+        , _objectsPerSlab{(kSlabSize - _firstObject) / _stride}
+        , _constructor{constructor}
+    {}
+
+    SlabCache(SlabCache const &) = delete;
+    SlabCache &operator=(SlabCache const &) = delete;
+
+    /** Allocates an object. O(1), unless a new slab is needed. Returns nullptr if memory runs out. */
+    void *alloc();
+
+    /** Frees an object from this cache. O(1). */
+    void free(void *object);
+
+    /** Gives the slabs with nothing allocated from them back to the page allocator. */
+    void shrink();
+
+    [[nodiscard]] char const *name() const { return _name; }
+
+    /** The size of the objects, as given to the constructor. */
+    [[nodiscard]] std::size_t objectSize() const { return _objectSize; }
+
+    /** The number of objects handed out. */
+    [[nodiscard]] std::size_t objectsInUse() const { return _objectsInUse; }
+
+    /** The number of slabs, and so pages, the cache holds. */
+    [[nodiscard]] std::size_t slabCount() const { return _slabCount; }
+
+    /** Writes a `HEAPPROF CLASS` line on how full the cache's slabs are, for the heap profile. */
+    void report(sys::OutputStream &out) const;
+
+    /**
+     * The cache an object was allocated from. Only valid for objects from a
+     * SlabCache, or for memory whose page starts with a null pointer, for which
+     * it returns nullptr.
+     */
+    static SlabCache *cacheOf(void *object) { return slabOf(object)->cache; }
+
+  private:
+    /** Most empty slabs kept around, so that alloc/free at a slab boundary doesn't thrash. */
+    static constexpr std::size_t const kMaxEmptySlabs = 1;
+
+    struct Slab
+    {
+        SlabCache *cache; ///< Kept first, see cacheOf().
+        Slab *prev;
+        Slab *next;
+        void *freeList;
+        std::size_t inUse;
+    };
+
+    /** A doubly linked list of slabs. */
+    struct SlabList
+    {
+        Slab *head = nullptr;
+
+        void push(Slab *slab);
+        void remove(Slab *slab);
+    };
+
+    static constexpr std::size_t roundUp(std::size_t value, std::size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    static constexpr std::size_t max(std::size_t a, std::size_t b) { return a < b ? b : a; }
+
+    static Slab *slabOf(void *object)
+    {
+        return reinterpret_cast<Slab *>(reinterpret_cast<std::uintptr_t>(object) & ~(kSlabSize - 1));
+    }
+
+    void *&linkOf(void *object) const
+    {
+        return *reinterpret_cast<void **>(static_cast<std::byte *>(object) + _linkOffset);
+    }
+
+    /** Takes a new slab from the page allocator and lays out its objects. */
+    Slab *grow();
+
+    char const *_name;
+    std::size_t _objectSize;
+    std::size_t _linkOffset; ///< Where in a free object the free list link lives.
+    std::size_t _stride;
+    std::size_t _firstObject; ///< Offset of the first object in a slab.
+    std::size_t _objectsPerSlab;
+    Constructor _constructor;
+
+    SlabList _partial{};
+    SlabList _full{};
+    SlabList _empty{};
+    std::size_t _emptySlabs = 0;
+    std::size_t _slabCount = 0;
+    std::size_t _objectsInUse = 0;
+};
+
+/** A SlabCache of one type, which constructs and destroys its objects. */
+template <typename T>
+class ObjectCache : public SlabCache
+{
+  public:
+    static_assert(sizeof(T) <= kMaxObjectSize, "too big for a slab cache");
+
+    constexpr explicit ObjectCache(char const *name) : SlabCache(name, sizeof(T), alignof(T)) {}
+
+    template <typename... Args>
+    T *create(Args &&...args)
+    {
+        void *memory = alloc();
+        return memory ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    void destroy(T *object)
+    {
+        if (object) {
+            object->~T();
+            free(object);
+        }
+    }
+};
+
+/**
+ * Base class for kernel types that get a slab cache of their own. Their `new`
+ * and `delete` go to the cache; a derived type of a different size goes to
+ * the heap.
+ */
+template <typename T>
+class SlabAllocated
+{
+  public:
+    static void *operator new(std::size_t bytes) noexcept
+    {
+        if (bytes != sizeof(T)) { return ::operator new(bytes, std::nothrow); }
+
+        void *object = cache().alloc();
+        profileAllocation(object, bytes, __builtin_return_address(0));
+        return object;
+    }
+
+    /** Placement new, which the class-specific new above would otherwise hide. */
+    static void *operator new(std::size_t, void *place) noexcept { return place; }
+
+    static void operator delete(void *object, std::size_t bytes) noexcept
+    {
+        if (bytes == sizeof(T)) {
+            profileFree(object);
+            cache().free(object);
+        } else {
+            ::operator delete(object);
+        }
+    }
+
+    static SlabCache &cache()
+    {
+        static constinit ObjectCache<T> s_cache{__PRETTY_FUNCTION__};
+        return s_cache;
+    }
+};
+
+/**
+ * The kernel's sys::ObjectAllocator: a slab cache for each power-of-two size
+ * class up to 512 bytes. Bigger objects go to the heap.
+ */
+class SlabObjectAllocator : public sys::ObjectAllocator
+{
+  public:
+    constexpr SlabObjectAllocator() = default;
+
+    void *allocate(std::size_t size) noexcept override;
+    void deallocate(void *object, std::size_t size) noexcept override;
+
+    /** Writes a `HEAPPROF CLASS` line for each size class. */
+    void report(sys::OutputStream &out) const;
+
+  private:
+    static constexpr std::size_t const kSizeClasses = 6;
+    static constexpr std::size_t const kSmallestClass = 16;
+
+    /** The index of the smallest size class holding `size` bytes, or kSizeClasses if there is none. */
+    static std::size_t sizeClass(std::size_t size);
+
+    SlabCache _caches[kSizeClasses]{{"object-16", 16},  {"object-32", 32},   {"object-64", 64},
+                                    {"object-128", 128}, {"object-256", 256}, {"object-512", 512}};
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Records the virtual memory areas an address space owns: what each range is
+ * for, how it may be accessed and what backs it.
+ *
+ * Areas are kept in a sorted array of disjoint ranges, so finding the area
+ * holding an address is a binary search. Like VirtualRangeAllocator, the array
+ * has a fixed capacity because the map sits underneath the kernel heap.
+ */
+class VirtualMemoryMap
+{
+  public:
+    static constexpr std::size_t const kMaxAreas = 128;
+
+    /** Access rights. The values match the ELF program header flags. */
+    enum Protection : std::uint8_t
+    {
+        kProtNone = 0x0,
+        kProtExecute = 0x1,
+        kProtWrite = 0x2,
+        kProtRead = 0x4,
+    };
+
+    /** What the contents of an area come from. */
+    enum class Backing : std::uint8_t
+    {
+        kAnonymous,  ///< Zero-filled memory.
+        kFile,       ///< An in-memory copy of a file.
+        kElfSegment, ///< A loadable segment of an executable.
+    };
+
+    enum AreaFlag : std::uint8_t
+    {
+        kAreaNone = 0x0,
+        kAreaDemandPaged = 0x1, ///< Pages are only backed once touched.
+        kAreaLargePages = 0x2,  ///< Mapped with 4 MiB pages.
+        kAreaMapped = 0x4,      ///< Made by sys_mmap, and so the only kind sys_munmap may remove.
+    };
+
+    struct Area
+    {
+        std::uintptr_t start = 0;
+        std::uintptr_t end = 0;
+        std::uint8_t protection = kProtNone;
+        Backing backing = Backing::kAnonymous;
+        std::uint8_t flags = kAreaNone;
+        std::byte const *data = nullptr; ///< The initial contents, if not anonymous.
+        std::size_t dataSize = 0;        ///< The size of data, in bytes. The rest of the area is zeroed.
+
+        [[nodiscard]] bool contains(std::uintptr_t address) const { return address >= start && address < end; }
+
+        /** The initial contents of the page at `page`, which may be short or empty. */
+        [[nodiscard]] std::byte const *dataFor(std::uintptr_t page, std::size_t *size) const;
+    };
+
+    /**
+     * Finds the area holding an address.
+     * @return The area, or nullptr if the address isn't part of one.
+     */
+    [[nodiscard]] Area const *find(std::uintptr_t address) const;
+
+    /** Whether every address in [start, end) is part of some area, and each of those areas has all of `flags`. */
+    [[nodiscard]] bool covers(std::uintptr_t start, std::uintptr_t end, std::uint8_t flags = kAreaNone) const;
+
+    /**
+     * Adds an area. An anonymous area is merged into anonymous neighbours it
+     * touches if they have the same protection and flags.
+     * @return false if it overlaps an existing area or the map is full.
+     */
+    bool insert(Area const &area);
+
+    /**
+     * Removes [start, end) from the map, trimming or splitting the areas it
+     * overlaps.
+     * @return false if an area would need splitting but the map is full. The
+     *         map is unchanged then.
+     */
+    bool remove(std::uintptr_t start, std::uintptr_t end);
+
+    [[nodiscard]] std::size_t size() const { return _count; }
+    [[nodiscard]] Area const *begin() const { return _areas; }
+    [[nodiscard]] Area const *end() const { return _areas + _count; }
+
+  private:
+    /** The index of the first area starting above `address`. */
+    [[nodiscard]] std::size_t upperBound(std::uintptr_t address) const;
+
+    /** Whether two adjacent areas can be recorded as one. */
+    static bool mergeable(Area const &lower, Area const &upper);
+
+    /** Moves the start of an area up, keeping its initial data lined up. */
+    static void trimFront(Area &area, std::uintptr_t newStart);
+
+    void insertAt(std::size_t index, Area const &area);
+    void erase(std::size_t first, std::size_t last);
+
+    Area _areas[kMaxAreas]{};
+    std::size_t _count = 0;
+};
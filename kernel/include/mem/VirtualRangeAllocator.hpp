@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Tracks the free virtual address ranges of an address space.
+ *
+ * Free space is kept as a sorted array of disjoint, non-adjacent extents (in
+ * pages), so reserving or releasing a particular range is a binary search,
+ * and finding a hole only looks at the holes rather than at page tables.
+ * The array has a fixed capacity because the allocator sits underneath the
+ * kernel heap and can't use it.
+ */
+class VirtualRangeAllocator
+{
+  public:
+    static constexpr std::size_t const kMaxExtents = 128;
+
+    VirtualRangeAllocator() = default;
+
+    /**
+     * Creates an allocator that manages [begin, end).
+     * @param begin The first address to manage. Must be page aligned.
+     * @param end The end of the managed range. Must be page aligned.
+     */
+    VirtualRangeAllocator(std::uintptr_t begin, std::uintptr_t end) { release(begin, (end - begin) / kPageSize); }
+
+    /**
+     * Takes the lowest free range of the given length.
+     * @param pages The length of the range, in pages.
+     * @param alignment The alignment of the start of the range, in pages. Must be a power of two.
+     * @return The start of the range, or 0 if there is no hole big enough.
+     */
+    std::uintptr_t allocate(std::size_t pages, std::size_t alignment = 1);
+
+    /**
+     * Takes a specific range.
+     * @param address The start of the range. Must be page aligned.
+     * @param pages The length of the range, in pages.
+     * @return false if any part of the range was not free; nothing is taken then.
+     */
+    bool reserve(std::uintptr_t address, std::size_t pages);
+
+    /**
+     * Gives a range back, merging it with neighbouring free ranges.
+     * @param address The start of the range. Must be page aligned.
+     * @param pages The length of the range, in pages.
+     * @return false if part of the range is already free, or if there are too many free ranges to record
+     *         another; nothing is given back then.
+     */
+    bool release(std::uintptr_t address, std::size_t pages);
+
+    /** The number of free pages. */
+    [[nodiscard]] std::size_t freePages() const { return _freePages; }
+
+  private:
+    static constexpr std::uintptr_t const kPageSize = 0x1000;
+
+    /** A free range of pages, [first, first + count). */
+    struct Extent
+    {
+        std::uint32_t first;
+        std::uint32_t count;
+
+        [[nodiscard]] std::uint32_t end() const { return first + count; }
+    };
+
+    /** The index of the first extent starting above `page`. */
+    [[nodiscard]] std::size_t upperBound(std::uint32_t page) const;
+
+    void insert(std::size_t index, Extent extent);
+    void erase(std::size_t index);
+
+    Extent _extents[kMaxExtents]{};
+    std::size_t _count = 0;
+    std::size_t _freePages = 0;
+};
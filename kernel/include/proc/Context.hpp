@@ -9,6 +9,7 @@
 #include <io/InputStream.hpp>
 #include <io/OutputStream.hpp>
 #include <mem/AddressSpace.hpp>
+#include <mem/Heap.hpp>
 
 class Context
 {
@@ -54,9 +55,22 @@ class Context
     AddressSpace addressSpace() const { return _addressSpace; }
     void setAddressSpace(AddressSpace addressSpace) { _addressSpace = addressSpace; }
 
+    /**
+     * Returns the heap `sbrk()` grows for the running program.
+     * @return The heap, or nullptr if no program is running.
+     */
+    Heap *heap() const { return _heap; }
+
+    /**
+     * Sets the heap of the running program.
+     * @param heap The heap to set, or nullptr.
+     */
+    void setHeap(Heap *heap) { _heap = heap; }
+
   private:
     sys::ArcPtr<sys::InputStream> _in;
     Console *_console;
     sys::OutputStream *_out;
     AddressSpace _addressSpace;
+    Heap *_heap = nullptr;
 };
@@ -9,6 +9,8 @@
 #include <util/Maybe.hpp>
 #include <util/String.hpp>
 
+class Heap;
+
 using FileHandle = std::size_t;
 
 struct Process
@@ -22,8 +24,13 @@ struct Process
 
     std::uint32_t sz;                      // Size of process memory (bytes)
     PageTable *pgdir;                      // Page table
+    Heap *heap;                            // Heap grown by sbrk(), if running a program
     std::byte *kernStack;                  // Bottom of kernel stack for this process
     State state;                           // Process state
+    std::uint8_t priority;                 // Scheduling priority, 0 is the most urgent
+    Process *runNext;                      // Next process in its run queue
+    Process *runPrev;                      // Previous process in its run queue
+    std::uint32_t ticksLeft;               // Timer ticks left in its time slice
     ID pid;                                // Process ID
     Process *parent;                       // Parent process
     ICpuState *procState;                  // architecture-dependent state (trap frame, context, channel)
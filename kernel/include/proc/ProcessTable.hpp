@@ -0,0 +1,57 @@
+#pragma once
+
+#include <mem/SlabCache.hpp>
+#include <proc/Process.hpp>
+#include <util/BitSet.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Every process in the system, by pid.
+ *
+ * Processes are allocated from a slab cache of their own, so a Process never
+ * moves once created and pointers to it stay valid until it's removed. Each
+ * process takes one of kMaxProcesses slots, and its pid encodes the slot:
+ *
+ *     pid = generation * kMaxProcesses + slot
+ *
+ * so looking a pid up is a single array index, with no hashing and no scan.
+ * A slot's generation is bumped whenever it is freed, so a recycled slot hands
+ * out a new pid, and a stale pid finds nothing rather than a stranger.
+ */
+class ProcessTable
+{
+  public:
+    static constexpr std::size_t const kMaxProcesses = 64;
+
+    ProcessTable() = default;
+    ProcessTable(ProcessTable const &) = delete;
+    ProcessTable &operator=(ProcessTable const &) = delete;
+
+    /**
+     * Moves a process into the table and gives it a pid.
+     * @return The process's permanent home, or nullptr if the table or memory is full.
+     */
+    Process *insert(Process &&process);
+
+    /** The process with the given pid, or nullptr if there is none. O(1). */
+    [[nodiscard]] Process *find(Process::ID pid) const;
+
+    /** Destroys a process and frees its slot and pid. */
+    void remove(Process &process);
+
+    /** The number of processes in the table. */
+    [[nodiscard]] std::size_t size() const { return used_.count(); }
+
+  private:
+    /** Generations wrap before a pid would overflow Process::ID. */
+    static constexpr std::uint32_t const kGenerations = 0x7FFFFFFF / kMaxProcesses;
+
+    static std::size_t slotOf(Process::ID pid) { return std::size_t(pid) % kMaxProcesses; }
+
+    ObjectCache<Process> cache_{"process"};
+    Process *slots_[kMaxProcesses]{};
+    std::uint32_t generations_[kMaxProcesses]{};
+    sys::BitSet<kMaxProcesses> used_;
+};
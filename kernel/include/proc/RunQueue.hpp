@@ -0,0 +1,87 @@
+#pragma once
+
+#include <proc/Process.hpp>
+#include <util/BitSet.hpp>
+
+#include <algorithm>
+#include <cstddef>
+
+/**
+ * The runnable processes, as one FIFO queue per priority level.
+ *
+ * Processes are linked through their own runNext/runPrev fields, so queueing
+ * never allocates, and a bitmap of the non-empty levels finds the most urgent
+ * one with a single bit scan. Every operation is O(1), however many processes
+ * there are.
+ *
+ * Level 0 is the most urgent. A process must be in at most one queue at a time.
+ */
+class RunQueue
+{
+  public:
+    static constexpr std::size_t const kPriorityLevels = 32;
+
+    [[nodiscard]] bool empty() const { return nonEmpty_.findFirstSet() == Levels::kNotFound; }
+
+    /** The process dequeue() would return, or nullptr if there is none. */
+    [[nodiscard]] Process *front() const
+    {
+        auto const level = nonEmpty_.findFirstSet();
+        return level == Levels::kNotFound ? nullptr : queues_[level].head;
+    }
+
+    /** Adds a process to the back of its priority level. */
+    void enqueue(Process &process)
+    {
+        auto &queue = queues_[levelOf(process)];
+        process.runNext = nullptr;
+        process.runPrev = queue.tail;
+        if (queue.tail) {
+            queue.tail->runNext = &process;
+        } else {
+            queue.head = &process;
+            nonEmpty_.set(levelOf(process));
+        }
+        queue.tail = &process;
+    }
+
+    /** Takes a process out of its queue, wherever it is in it. */
+    void remove(Process &process)
+    {
+        auto &queue = queues_[levelOf(process)];
+        (process.runPrev ? process.runPrev->runNext : queue.head) = process.runNext;
+        (process.runNext ? process.runNext->runPrev : queue.tail) = process.runPrev;
+        process.runNext = process.runPrev = nullptr;
+        if (!queue.head) {
+            nonEmpty_.unset(levelOf(process));
+        }
+    }
+
+    /** Removes and returns the first process of the most urgent level, or nullptr if there is none. */
+    Process *dequeue()
+    {
+        auto *process = front();
+        if (process) {
+            remove(*process);
+        }
+        return process;
+    }
+
+    /** The level a process is queued at. Priorities past the last level share it. */
+    [[nodiscard]] static std::size_t levelOf(Process const &process)
+    {
+        return std::min<std::size_t>(process.priority, kPriorityLevels - 1);
+    }
+
+  private:
+    using Levels = sys::BitSet<kPriorityLevels>;
+
+    struct Queue
+    {
+        Process *head = nullptr;
+        Process *tail = nullptr;
+    };
+
+    Queue queues_[kPriorityLevels]{};
+    Levels nonEmpty_;
+};
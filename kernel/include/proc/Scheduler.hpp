@@ -5,43 +5,96 @@
 #pragma once
 
 #include <proc/Process.hpp>
-#include <util/ArrayList.hpp>
+#include <proc/ProcessTable.hpp>
+#include <proc/RunQueue.hpp>
 
-#include <ranges>
+#include <algorithm>
+#include <cstdint>
 #include <utility>
 
 class Scheduler
 {
   public:
+    /** The length of a time slice at every priority level until set otherwise, in timer ticks. */
+    static constexpr std::uint32_t const kDefaultQuantum = 5;
+
+    Scheduler() { std::ranges::fill(quanta_, kDefaultQuantum); }
+
     Process const * currentProcess() const { return activeProcess_; }
     Process       * currentProcess()       { return activeProcess_; }
-    void setCurrentProcess(Process *process) { activeProcess_ = process; }
 
-    bool hasRunnableProcess() const
-    {
-        return std::ranges::find_if(dormantProcesses_, [](Process const &p) {
-            return p.state == Process::State::Runnable;
-        }) != dormantProcesses_.end();
-    }
+    /** Makes a process the current one, taking it out of the run queue if it was waiting there. */
+    void setCurrentProcess(Process *process);
+
+    bool hasRunnableProcess() const { return !runQueue_.empty(); }
 
-    /** Enqueues an embryo process into the dormant process list. */
+    /**
+     * Moves an embryo process into the process table and gives it a pid.
+     * @return The process, which stays put until destroyed, or nullptr if the table is full.
+     */
     Process *enqueueEmbryo(Process&& process);
 
+    /** The process with the given pid, or nullptr if there is none. */
+    Process *findProcess(Process::ID pid) const { return processes_.find(pid); }
+
+    /** Takes a process out of scheduling and frees it and its pid. */
+    void destroyProcess(Process& process);
+
     /**
      * Marks an embryo process runnable once architecture-specific CPU state has
      * been attached.
      */
     bool makeRunnable(Process& process, Process::ICpuState *cpuState);
 
+    /**
+     * Changes a process's state, adding it to or removing it from the run
+     * queue as it becomes or stops being runnable.
+     */
+    void setState(Process& process, Process::State state);
+
+    /**
+     * The process that should run next: the first one in the most urgent
+     * non-empty run queue level, unless the current process is more urgent.
+     */
     Process * nextProcess();
 
-    /** Selects the next process and marks it as the current process. */
+    /**
+     * Selects the next process and marks it as the current process, with a
+     * fresh time slice if it needs one. Clears any reschedule request. If
+     * nothing can run, the current process stays current even if it is not
+     * running.
+     */
     Process *promoteNextProcessToCurrent();
 
-    Process::ID nextPid() { return nextPid_++; }
+    /** The length of a time slice at a priority level, in timer ticks. */
+    std::uint32_t quantum(std::size_t level) const { return quanta_[level]; }
+
+    /** Sets the length of a time slice at a priority level. Slices are at least one tick. */
+    void setQuantum(std::size_t level, std::uint32_t ticks) { quanta_[level] = std::max<std::uint32_t>(ticks, 1); }
+
+    /**
+     * Charges a timer tick to the current process, and asks for a reschedule
+     * once its time slice has run out. Called from the timer interrupt.
+     */
+    void tick();
+
+    /**
+     * Whether the current process should give the CPU up. Checked on the way
+     * out of every interrupt and syscall.
+     */
+    bool needsReschedule() const { return needResched_; }
+    void requestReschedule() { needResched_ = true; }
+    void cancelReschedule() { needResched_ = false; }
+
+    /** Gives up the rest of the current process's time slice. */
+    void yield();
 
   private:
+    std::uint32_t quantumFor(Process const &process) const { return quanta_[RunQueue::levelOf(process)]; }
+
     Process *activeProcess_ = nullptr;
-    sys::ArrayList<Process> dormantProcesses_;
-    Process::ID nextPid_ = 0;
+    ProcessTable processes_;
+    RunQueue runQueue_;
+    std::uint32_t quanta_[RunQueue::kPriorityLevels];
+    bool needResched_ = false;
 };
@@ -46,6 +46,7 @@ class Executable
         , _segments{std::move(rhs._segments)}
         , _nameTable{rhs._nameTable}
         , _entry{rhs._entry}
+        , _heap{rhs._heap}
         , _isLoaded{rhs._isLoaded}
     {
         rhs._isLoaded = false;
@@ -58,7 +59,8 @@ class Executable
     [[nodiscard]] sys::ArrayList<Section> const &sections() const { return _sections; }
 
     /**
-     * Loads the program segments into memory.
+     * Loads the program segments into memory. The program's heap starts on the
+     * page after the last segment.
      * @return `true` if the segments are loaded, `false` otherwise.
      */
     bool loadSegments();
@@ -73,14 +75,14 @@ class Executable
     {
         constexpr auto argc = sizeof...(Args);
         char const *argv[argc] = {args...};
-        return loadSegments() ? _entry(argc, argv) : -1;
+        return loadSegments() ? run(argc, argv) : -1;
     }
 
     template <std::same_as<char const *>... Args>
     int operator()(Args...args) { return exec(args...); }
 
     /**
-     * Unloads the program segments from memory.
+     * Unloads the program segments and heap from memory.
      * @return `true` if the segments are unloaded, `false` otherwise.
      */
     bool unloadSegments();
@@ -110,6 +112,7 @@ class Executable
         uint32_t alignment = 0;
         uint32_t dataSize = 0;
         uint32_t memorySize = 0;
+        uint32_t flags = 0;
 
         Segment() {}
 
@@ -123,6 +126,9 @@ class Executable
     };
 
   private:
+    /** Calls the entry point with the program's heap in place for `sbrk()`. */
+    int run(int argc, char const *argv[]);
+
     size_t loadProgramSegments(size_t offset, size_t entryCount);
     size_t loadSections(size_t offset, size_t entryCount, size_t nameTableIndex);
     void loadNameTable(size_t offset, size_t entryIndex);
@@ -132,6 +138,7 @@ class Executable
     sys::ArrayList<Segment> _segments{};
     Section const *_nameTable = nullptr;
     EntryType _entry = nullptr;
+    Heap _heap{0, 0};
     bool _isLoaded = false;
 };
 
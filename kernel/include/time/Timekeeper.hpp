@@ -0,0 +1,67 @@
+#pragma once
+
+#include <time/TimerDevice.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/**
+ * Keeps the system's tick count, and decides how the timer interrupts.
+ *
+ * While the kernel has work, the timer ticks periodically, which is what time
+ * slices are measured in. When it goes idle, the periodic tick is replaced by
+ * a single interrupt at the next deadline anyone is waiting for, re-armed as
+ * often as the device's range requires, or by no timer interrupt at all if
+ * nothing is waiting. The tick count is brought up to date from the device
+ * when the CPU wakes, so it keeps counting through idle periods with a
+ * deadline. With no deadline and the timer stopped, it stands still until
+ * something wakes the CPU: there is nothing to measure the wait against.
+ */
+class Timekeeper
+{
+  public:
+    static constexpr std::uint64_t const kNoDeadline = std::numeric_limits<std::uint64_t>::max();
+
+    /** Starts the periodic tick on a device. */
+    void install(TimerDevice &device);
+
+    /** Ticks since the timer was installed. */
+    [[nodiscard]] std::uint64_t ticks() const { return _ticks; }
+
+    /**
+     * Sets the tick the next timer expires at, or kNoDeadline. Idle periods
+     * end by then.
+     */
+    void setNextDeadline(std::uint64_t tick) { _deadline = tick; }
+    [[nodiscard]] std::uint64_t nextDeadline() const { return _deadline; }
+
+    /** Accounts a timer interrupt. */
+    void interrupt();
+
+    /**
+     * Swaps the periodic tick for a one-shot at the next deadline, or for
+     * nothing if there isn't one. Call with interrupts disabled, right before
+     * halting.
+     */
+    void enterIdle();
+
+    /** Catches up with the time spent idle and restarts the periodic tick. */
+    void exitIdle();
+
+  private:
+    enum class Mode { kStopped, kPeriodic, kOneShot };
+
+    /** Adds elapsed device cycles to the tick count. */
+    void advance(std::uint32_t cycles);
+
+    /** Programs a one-shot for the deadline, or as far towards it as the device goes. */
+    void armOneShot();
+
+    TimerDevice *_device = nullptr;
+    Mode _mode = Mode::kStopped;
+    std::uint64_t _ticks = 0;
+    std::uint32_t _residue = 0; ///< Cycles short of a whole tick.
+    std::uint32_t _armed = 0;   ///< Cycles the pending one-shot was programmed for.
+    std::uint64_t _deadline = kNoDeadline;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * A programmable interrupt timer, as the Timekeeper drives it.
+ *
+ * Times are in the device's own clock cycles, so nothing is lost to rounding;
+ * cyclesPerTick() relates them to scheduler ticks.
+ */
+class TimerDevice
+{
+  public:
+    virtual ~TimerDevice() = default;
+
+    /** Device clock cycles per scheduler tick. */
+    [[nodiscard]] virtual std::uint32_t cyclesPerTick() const = 0;
+
+    /** The longest one-shot delay the device can be programmed with, in cycles. */
+    [[nodiscard]] virtual std::uint32_t maxOneShot() const = 0;
+
+    /** Interrupts once every tick. */
+    virtual void startPeriodic() = 0;
+
+    /** Interrupts once, `cycles` cycles from now. At most maxOneShot(). */
+    virtual void startOneShot(std::uint32_t cycles) = 0;
+
+    /** Stops interrupting altogether. */
+    virtual void stop() = 0;
+
+    /** Cycles until the pending one-shot fires. */
+    [[nodiscard]] virtual std::uint32_t remaining() const = 0;
+};
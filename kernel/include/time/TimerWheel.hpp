@@ -0,0 +1,95 @@
+#pragma once
+
+#include <util/BitSet.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+/**
+ * A callback to run at a given tick. Owned by whoever arms it, which must keep
+ * it alive until it has fired or been cancelled.
+ */
+struct Timer
+{
+    using Callback = void (*)(Timer &timer);
+
+    Callback callback = nullptr; ///< Runs from the timer interrupt, with interrupts disabled.
+    void *context = nullptr;     ///< For the callback's use.
+
+    std::uint64_t expires = 0; ///< The tick the timer fires at.
+    Timer *next = nullptr;
+    Timer *prev = nullptr;
+    std::uint8_t level = 0;
+    std::uint8_t slot = 0;
+    bool pending = false; ///< Armed, and neither fired nor cancelled.
+};
+
+/**
+ * Timers, in a hashed hierarchical timing wheel after Varghese and Lauck.
+ *
+ * Each of kLevels wheels has kSlots slots, each slot a list of the timers due
+ * in it. A slot on level 0 covers one tick, one on level 1 covers kSlots
+ * ticks, and so on, so a timer goes on the lowest level its expiry is within
+ * range of, in the slot its expiry hashes to. Adding and cancelling a timer
+ * are O(1). Every tick expires one level 0 slot, and each time a level comes
+ * full circle, the next level's current slot is cascaded down a level,
+ * spreading its timers over the finer slots below.
+ *
+ * Timers further out than the top level reaches are parked in its last slot
+ * and cascaded down until they fall within range.
+ */
+class TimerWheel
+{
+  public:
+    static constexpr std::size_t const kLevels = 4;
+    static constexpr std::size_t const kSlotBits = 6;
+    static constexpr std::size_t const kSlots = 1u << kSlotBits;
+
+    static constexpr std::uint64_t const kNever = std::numeric_limits<std::uint64_t>::max();
+
+    /** The tick the wheel has run up to. */
+    [[nodiscard]] std::uint64_t now() const { return _now; }
+
+    [[nodiscard]] bool empty() const { return _pending == 0; }
+
+    /** Arms a timer to fire at tick `expires`, or on the next tick if that has passed. Re-arms a pending one. */
+    void add(Timer &timer, std::uint64_t expires);
+
+    /** Disarms a timer. Does nothing if it isn't pending. */
+    void cancel(Timer &timer);
+
+    /** Runs the wheel up to tick `tick`, firing every timer due by then. */
+    void advance(std::uint64_t tick);
+
+    /**
+     * A tick at or before the earliest pending expiry, or kNever. Exact for
+     * timers on level 0; for the others it's when their slot next cascades.
+     */
+    [[nodiscard]] std::uint64_t nextExpiry() const;
+
+  private:
+    struct Slot
+    {
+        Timer *head = nullptr;
+        Timer *tail = nullptr;
+    };
+
+    static constexpr std::size_t shiftOf(std::size_t level) { return level * kSlotBits; }
+    static constexpr std::size_t slotIndex(std::uint64_t tick, std::size_t level)
+    {
+        return std::size_t(tick >> shiftOf(level)) & (kSlots - 1);
+    }
+
+    /** Puts a timer in the slot its expiry belongs in, as seen from _now. */
+    void insert(Timer &timer);
+    void unlink(Timer &timer);
+
+    /** Moves every timer in a slot down to where it now belongs. */
+    void cascade(std::size_t level, std::size_t slot);
+
+    Slot _slots[kLevels][kSlots]{};
+    sys::BitSet<kSlots> _occupied[kLevels]{};
+    std::uint64_t _now = 0;
+    std::size_t _pending = 0;
+};
@@ -3,6 +3,10 @@
 //
 
 #include <Kernel.hpp>
+#include <cpu/InterruptGuard.hpp>
+#include <mem/HeapProfiler.hpp>
+#include <mem/KernelHeap.hpp>
+#include <system/asm.h>
 #include <system/Debug.hpp>
 #include <util/StringView.hpp>
 
@@ -11,6 +15,62 @@
 //======================================================
 // Kernel
 //======================================================
+void Kernel::idle()
+{
+    // use the time to clear a frame for later, or sleep if there's nothing left to clear
+    if (_mmu && _mmu->prepareZeroedFrame()) {
+        return;
+    }
+
+    // the timer only needs to tick while there are time slices to hand out
+    auto const flags = irq_save();
+    bool const tickless = !_scheduler || !_scheduler->hasRunnableProcess();
+    if (tickless) {
+        _timekeeper.enterIdle();
+    }
+
+    sti_halt();
+
+    cli();
+    if (tickless) {
+        _timekeeper.exitIdle();
+        runTimers();
+    }
+    irq_restore(flags);
+}
+
+void Kernel::addTimer(Timer &timer, std::uint64_t expires)
+{
+    InterruptGuard guard;
+    _timers.add(timer, expires);
+    _timekeeper.setNextDeadline(_timers.nextExpiry());
+}
+
+void Kernel::cancelTimer(Timer &timer)
+{
+    InterruptGuard guard;
+    _timers.cancel(timer);
+    _timekeeper.setNextDeadline(_timers.nextExpiry());
+}
+
+void Kernel::runTimers()
+{
+    _timers.advance(_timekeeper.ticks());
+    _timekeeper.setNextDeadline(_timers.nextExpiry());
+}
+
+void Kernel::dumpHeapProfile() const
+{
+    sys::BochsDebugOutputStream out{};
+    sys::println(out, "HEAPPROF BEGIN");
+#ifdef LAMBOS_HEAP_PROFILER
+    HeapProfiler::instance().dump(out);
+#endif
+    KernelHeap::instance().report(out);
+    _objectAllocator.report(out);
+    sys::println(out, "HEAPPROF END");
+}
+
 void Kernel::panic(char const *string)
 {
     DEBUG_BREAK();
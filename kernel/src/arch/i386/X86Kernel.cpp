@@ -3,13 +3,41 @@
 //
 
 #include <arch/i386/X86Kernel.hpp>
+#include <arch/i386/device/pit/PIT.hpp>
 #include <arch/i386/proc/X86Process.hpp>
 #include <arch/i386/sys/Syscall.hpp>
 #include <device/display/VGATextConsole.hpp>
 #include <device/display/ConsoleOutputStream.hpp>
 
+#include <cpu/InterruptGuard.hpp>
+
+#include <cstddef>
 #include <new>
 
+namespace {
+
+/** The size of a spawned process's kernel stack, in pages. Programs run on it too. */
+constexpr std::size_t const kStackPages = 4;
+
+/** What a new process's stack holds, for context_switch() to return into startProcess(). */
+struct InitialFrame
+{
+    X86Process::State::Context context;
+    void *returnAddress;
+    void (*entry)(void *);
+    void *argument;
+};
+
+[[noreturn]] void startProcess(void (*entry)(void *), void *argument)
+{
+    // everything that switches to a process runs with interrupts disabled
+    sti();
+    entry(argument);
+    x86Kernel->exitProcess();
+}
+
+} // namespace
+
 X86Kernel::X86Kernel() : _x86cpu{}, _vgaConsole(), _consoleOutputStream(_vgaConsole)
 {
     setConsole(&_vgaConsole);
@@ -23,6 +51,9 @@ void X86Kernel::installMMU(uint32_t mmap_addr, uint32_t mmap_length)
     _mmu = _maybemmu.operator->();
     setAddressSpace(_mmu->create());
     _mmu->install(addressSpace());
+
+    // nothing can have been allocated before the MMU was up, so this is the time
+    sys::ObjectAllocator::install(&_objectAllocator);
 }
 
 void X86Kernel::installSyscalls()
@@ -32,9 +63,194 @@ void X86Kernel::installSyscalls()
 
 void X86Kernel::schedule()
 {
-//    auto curr = scheduler().currentProcess()->procState;
-//    auto next = scheduler().nextProcess()->procState;
-//    if (curr != next) {
-//        X86Process::swapActive(curr, next);
-//    }
-}
\ No newline at end of file
+    auto &processes = scheduler();
+    auto *curr = processes.currentProcess();
+
+    // nowhere to save the running code's registers, so it keeps the CPU
+    if (!curr || !curr->procState) {
+        processes.cancelReschedule();
+        return;
+    }
+
+    auto *next = processes.promoteNextProcessToCurrent();
+    if (!next || next == curr) {
+        return;
+    }
+
+    curr->heap = heap();
+    setHeap(next->heap);
+
+    if (next->pgdir && next->pgdir->address() != addressSpace().address()) {
+        setAddressSpace(*next->pgdir);
+        next->pgdir->install();
+    }
+
+    // returns once something switches back to curr
+    X86Process::swapActive(curr->procState, next->procState);
+}
+
+void X86Kernel::sleep(std::uint64_t nanoseconds)
+{
+    constexpr std::uint64_t kNanosecondsPerTick = 1'000'000'000 / PIT::kTickRate;
+    auto const ticks = (nanoseconds + kNanosecondsPerTick - 1) / kNanosecondsPerTick;
+    if (ticks == 0) {
+        return;
+    }
+
+    // with interrupts off, the timer can only fire while waiting, so a wakeup can't be missed
+    InterruptGuard guard;
+    auto &processes = scheduler();
+    auto *curr = processes.currentProcess();
+    bool const canSwitch = curr && curr->procState;
+
+    struct Sleeper
+    {
+        Process *process;
+        bool volatile done;
+    } sleeper{canSwitch ? curr : nullptr, false};
+
+    Timer timer{.callback = [](Timer &t) {
+                    auto &s = *static_cast<Sleeper *>(t.context);
+                    s.done = true;
+                    if (s.process) {
+                        kernel->scheduler().setState(*s.process, Process::State::Runnable);
+                    }
+                },
+                .context = &sleeper};
+
+    // the current tick is already partly over, so wait for one more
+    addTimer(timer, timekeeper().ticks() + ticks + 1);
+    if (canSwitch) {
+        processes.setState(*curr, Process::State::Sleeping);
+    }
+
+    while (!sleeper.done) {
+        if (canSwitch && processes.hasRunnableProcess()) {
+            schedule();
+        } else {
+            idle();
+        }
+    }
+
+    if (canSwitch) {
+        processes.setCurrentProcess(curr);
+    }
+}
+
+void X86Kernel::adoptBootProcess(char const *name, std::byte *stack)
+{
+    InterruptGuard guard;
+    auto &processes = scheduler();
+    Process process{};
+    process.name = sys::String{name};
+    auto *boot = processes.enqueueEmbryo(std::move(process));
+    auto *state = new X86Process::State{};
+    if (!boot || !state) {
+        panic("Unable to create the boot process.");
+    }
+
+    // its context is filled in the first time it is switched away from
+    state->addressSpace = addressSpace();
+    boot->pgdir = &state->addressSpace;
+    boot->kernStack = stack;
+    boot->heap = heap();
+    processes.makeRunnable(*boot, state);
+    processes.setCurrentProcess(boot);
+}
+
+Process *X86Kernel::spawn(char const *name, void (*entry)(void *), void *argument)
+{
+    InterruptGuard guard;
+    auto &processes = scheduler();
+    auto *parent = processes.currentProcess();
+    if (!parent || !parent->procState) {
+        return nullptr;
+    }
+
+    Process process{};
+    process.name = sys::String{name};
+    process.parent = parent;
+    process.priority = parent->priority;
+    auto *child = processes.enqueueEmbryo(std::move(process));
+    if (!child) {
+        return nullptr;
+    }
+
+    auto *state = new X86Process::State{};
+    auto *stack = static_cast<std::byte *>(palloc(kStackPages));
+    if (state && stack) { state->addressSpace = _mmu->create(); }
+    if (!state || !stack || !state->addressSpace.address()) {
+        if (stack) { pfree(stack, kStackPages); }
+        delete state;
+        processes.destroyProcess(*child);
+        return nullptr;
+    }
+
+    // context_switch() pops the context and returns into startProcess(), which
+    // finds its arguments above a return address it never uses
+    auto const top = reinterpret_cast<std::uintptr_t>(stack + kStackPages * kFrameSize);
+    auto const arguments = (top - 2 * sizeof(void *)) & ~std::uintptr_t(0xF);
+    auto *frame = reinterpret_cast<InitialFrame *>(arguments - offsetof(InitialFrame, entry));
+    *frame = InitialFrame{};
+    frame->context.eip = reinterpret_cast<std::uint32_t>(&startProcess);
+    frame->entry = entry;
+    frame->argument = argument;
+
+    state->context = &frame->context;
+    child->pgdir = &state->addressSpace;
+    child->kernStack = stack;
+    processes.makeRunnable(*child, state);
+    return child;
+}
+
+void X86Kernel::exitProcess()
+{
+    cli();
+    auto &processes = scheduler();
+    auto *curr = processes.currentProcess();
+    processes.setState(*curr, Process::State::Zombie);
+
+    auto *parent = curr->parent;
+    if (parent && parent->state == Process::State::Sleeping
+        && static_cast<X86Process::State *>(parent->procState)->chan == curr) {
+        processes.setState(*parent, Process::State::Runnable);
+    }
+
+    // a zombie is never picked to run again, so this only returns to wait for something to switch to
+    for (;;) {
+        if (processes.hasRunnableProcess()) {
+            schedule();
+        } else {
+            idle();
+        }
+    }
+}
+
+void X86Kernel::wait(Process &child)
+{
+    InterruptGuard guard;
+    auto &processes = scheduler();
+    auto *curr = processes.currentProcess();
+    auto *state = static_cast<X86Process::State *>(curr->procState);
+
+    // exitProcess() wakes the parent if it finds it asleep on the child
+    while (child.state != Process::State::Zombie) {
+        state->chan = &child;
+        processes.setState(*curr, Process::State::Sleeping);
+        if (processes.hasRunnableProcess()) {
+            schedule();
+        } else {
+            idle();
+        }
+    }
+
+    state->chan = nullptr;
+    processes.setCurrentProcess(curr);
+
+    // the child's stack and address space are no longer in use by anyone
+    auto *childState = static_cast<X86Process::State *>(child.procState);
+    _mmu->destroy(childState->addressSpace);
+    pfree(child.kernStack, kStackPages);
+    delete childState;
+    processes.destroyProcess(child);
+}
@@ -98,8 +98,13 @@ class PanicISR : public InterruptServiceRoutine
 
 extern "C" void interrupt_handler(RegisterTable registers)
 {
-    auto &cpu = static_cast<X86Kernel*>(kernel)->cpu();
-    cpu.idt().callISR(static_cast<InterruptNumber>(registers.int_no), registers);
+    auto *x86 = static_cast<X86Kernel*>(kernel);
+    x86->cpu().idt().callISR(static_cast<InterruptNumber>(registers.int_no), registers);
+
+    // on the way back to the interrupted code, which may have to make way first
+    if (x86->needsReschedule()) {
+        x86->schedule();
+    }
 }
 
 //======================================================
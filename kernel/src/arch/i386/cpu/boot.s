@@ -5,6 +5,15 @@
 .set MAGIC,    0x1BADB002       # 'magic number' lets bootloader find the header
 .set CHECKSUM, -(MAGIC + FLAGS) # checksum of above, to prove we are multiboot
 
+# The kernel is linked at KERNEL_VIRTUAL_BASE + its load address. Must match
+# kKernelVirtualBase in arch/i386/mem/DirectMap.hpp and linker.ld.
+.set KERNEL_VIRTUAL_BASE, 0xC0000000
+.set KERNEL_PDE_INDEX, KERNEL_VIRTUAL_BASE >> 22
+# Page tables mapping the first 16 MiB of physical memory, the kBootMapSize the
+# MMU expects to find when it builds the real direct map.
+.set BOOT_PAGE_TABLES, 4
+.set PAGE_PRESENT_WRITABLE, 0x3
+
 # Declare a header as in the Multiboot Standard. We put this into a special
 # section so we can force the header to be in the start of the final program.
 # You don't need to understand all these details as it is just magic values that
@@ -21,17 +30,70 @@
 # room for a small temporary stack by creating a symbol at the bottom of it,
 # then allocating 16384 bytes for it, and finally creating a symbol at the top.
 .section .bootstrap_stack
+.global stack_bottom
 stack_bottom:
 .skip 4096 # 4 KiB
 stack_top:
 
+# The page directory and tables that get us into the higher half. Both are
+# zeroed by the bootloader along with the rest of .bss.
+.section .bss
+.align 4096
+boot_page_directory:
+.skip 4096
+boot_page_tables:
+.skip 4096 * BOOT_PAGE_TABLES
+
 # The linker script specifies _start as the entry point to the kernel and the
 # bootloader will jump to this position once the kernel has been loaded. It
 # doesn't make sense to return from this function as the bootloader is gone.
-.section .text
+.section .boot.text, "ax"
 .global _start
 .type _start, @function
 _start:
+    # Paging is off and the kernel is linked in the higher half, so until we
+    # get there, everything has to be addressed physically. Don't touch eax and
+    # ebx, they hold the multiboot magic and info for kernel_main.
+
+    # Map the first 16 MiB page by page...
+    movl $(boot_page_tables - KERNEL_VIRTUAL_BASE), %edi
+    movl $PAGE_PRESENT_WRITABLE, %esi
+    movl $(1024 * BOOT_PAGE_TABLES), %ecx
+1:
+    movl %esi, (%edi)
+    addl $4096, %esi
+    addl $4, %edi
+    loop 1b
+
+    # ...both where it is, so that this code keeps running once paging is on,
+    # and at KERNEL_VIRTUAL_BASE, where the rest of the kernel expects it.
+    movl $(boot_page_tables - KERNEL_VIRTUAL_BASE + PAGE_PRESENT_WRITABLE), %edx
+    xorl %ecx, %ecx
+2:
+    movl %edx, (boot_page_directory - KERNEL_VIRTUAL_BASE)(,%ecx,4)
+    movl %edx, (boot_page_directory - KERNEL_VIRTUAL_BASE + KERNEL_PDE_INDEX * 4)(,%ecx,4)
+    addl $4096, %edx
+    incl %ecx
+    cmpl $BOOT_PAGE_TABLES, %ecx
+    jne 2b
+
+    movl $(boot_page_directory - KERNEL_VIRTUAL_BASE), %ecx
+    movl %ecx, %cr3
+    movl %cr0, %ecx
+    orl $0x80000000, %ecx
+    movl %ecx, %cr0
+
+    # An absolute jump, as a relative one would stay in the lower half. The
+    # identity mapping is left alone until the MMU installs its own directory.
+    movl $higher_half, %ecx
+    jmp *%ecx
+
+# Set the size of the _start symbol to the current location '.' minus its start.
+# This is useful when debugging or when you implement call tracing.
+.size _start, . - _start
+
+.section .text
+higher_half:
     # Welcome to kernel mode! We now have sufficient code for the bootloader to
     # load and run our operating system. It doesn't do anything interesting yet.
     # Perhaps we would like to call printf("Hello, World\n"). You should now
@@ -74,6 +136,3 @@ _start:
     hlt
     jmp .Lhang
 
-# Set the size of the _start symbol to the current location '.' minus its start.
-# This is useful when debugging or when you implement call tracing.
-.size _start, . - _start
@@ -7,8 +7,9 @@
 #include <arch/i386/cpu/X86.hpp>
 #include <arch/i386/cpu/X86RealTimeClock.hpp>
 #include <arch/i386/device/input/PS2KeyboardISR.hpp>
-#include <arch/i386/device/pit/PITIRQ.hpp>
+#include <arch/i386/device/pit/PIT.hpp>
 #include <arch/i386/device/storage/X86AtaDevice.hpp>
+#include <arch/i386/mem/DirectMap.hpp>
 #include <arch/i386/X86Kernel.hpp>
 #include <device/input/KeyboardInputStream.hpp>
 #include <fs/iso9660/Iso9660.hpp>
@@ -30,6 +31,7 @@ using sys::New;
 // Globals
 // ====================================================
 extern uint32_t kernel_end;
+extern uint32_t stack_bottom;
 VGA4BitColor defaultTextColor = COLOR_LIGHT_GREY;
 
 Kernel *kernel = nullptr;
@@ -50,6 +52,10 @@ extern "C++"
 template <typename Callable>
 int log_task(char const *printstr, Callable &&c);
 
+extern "C++"
+template <typename Callable>
+Process *run_process(char const *name, Callable &task);
+
 int check_flag(multiboot_info_t *info, char const *printstr, uint32_t flag);
 int log_test(char const *printstr, int success);
 
@@ -64,8 +70,28 @@ void perform_task(char const *desc, auto &&task)
     sys::debug_println("DONE.");
 }
 
+/**
+ * Runs a task as a process of its own. If one can't be started, the task runs
+ * right here instead.
+ * @return The process, to wait for before the task goes out of scope, or nullptr.
+ */
+extern "C++"
+template <typename Callable>
+Process *run_process(char const *name, Callable &task)
+{
+    auto *process = x86Kernel->spawn(name, [](void *t) { (*static_cast<Callable *>(t))(); }, &task);
+    if (!process) {
+        sys::debug_println("Unable to start %@, running it in place.", name);
+        task();
+    }
+    return process;
+}
+
 void kernel_main(multiboot_info_t *info, uint32_t magic)
 {
+    // the bootloader hands over a physical address, which boot.s mapped for us
+    info = X86::physicalToVirtual<multiboot_info_t>(reinterpret_cast<std::uintptr_t>(info));
+
     perform_task("Constructing kernel...", [] {
         // Get this party started
         x86Kernel = new(kern_mem) X86Kernel;
@@ -96,7 +122,8 @@ void init_system()
     // prepare stdin
     auto kb = New<PS2Keyboard>();
     PS2KeyboardISR::install(x86Kernel->cpu(), kb);
-    PITIRQ::install(x86Kernel->cpu());
+    kernel->timekeeper().install(*New<PITTimerDevice>());
+    PIT::installIRQ(x86Kernel->cpu());
     kernel->setIn(New<KeyboardInputStream>(kb));
     auto * const cd = read_ata();
     if (!cd)
@@ -117,16 +144,26 @@ void init_system()
     }
     puts("\n* * *");
 
+    // from here on, the programs run as processes of their own, preempting each other
+    x86Kernel->adoptBootProcess("init", reinterpret_cast<std::byte *>(&stack_bottom));
+
+    // each program is loaded in its own process, since they all link at the same address
     sys::debug_println("Finding /bin/proc-test...");
     auto proctestEntry = cd ? cd->find("/bin/proc-test") : nullptr;
-    if (proctestEntry) {
+    auto proctestA = [&] {
         auto proctest = elf::Executable(*proctestEntry);
-        printf("Running `proc-test A`...\n");
-        kernel->console()->setCursorVisible(true);
         proctest("A");
-        printf("Running `proc-test B`...\n");
-        kernel->console()->setCursorVisible(true);
+    };
+    auto proctestB = [&] {
+        auto proctest = elf::Executable(*proctestEntry);
         proctest("B");
+    };
+    Process *proctests[2]{};
+    if (proctestEntry) {
+        printf("Running `proc-test A` and `proc-test B`...\n");
+        kernel->console()->setCursorVisible(true);
+        proctests[0] = run_process("proc-test A", proctestA);
+        proctests[1] = run_process("proc-test B", proctestB);
     } else {
         puts("Unable to find proc-test! You might want to look into that.");
     }
@@ -135,15 +172,30 @@ void init_system()
     puts("");
 
     auto cvshEntry = cd ? cd->find("/bin/kvshell") : nullptr;
-    if (cvshEntry) {
+    auto shell = [&] {
         auto kvshell = elf::Executable(*cvshEntry);
+        kvshell.exec();
+    };
+    if (cvshEntry) {
         printf("Running kvshell...\n");
         kernel->console()->setCursorVisible(true);
-        kvshell.exec();
+        if (auto *process = run_process("kvshell", shell)) {
+            x86Kernel->wait(*process);
+        }
     } else {
         puts("Unable to find kvshell! You might want to look into that.");
     }
 
+    for (auto *process : proctests) {
+        if (process) {
+            x86Kernel->wait(*process);
+        }
+    }
+
+#ifdef LAMBOS_HEAP_PROFILER
+    kernel->dumpHeapProfile();
+#endif
+
     // mock developer
     kernel->console()->setForegroundColor(COLOR_LIGHT_RED);
     printf("Kernel exited. Maybe you should write the rest of the operating system?");
@@ -241,9 +293,11 @@ void read_multiboot(multiboot_info_t *info)
     if (!result) {
         kernel->panic("Fatal ERROR: Cannot install paging due to missing memory map.");
     } else {
+        auto const mmapStart = X86::physicalToVirtual<multiboot_memory_map_t>(info->mmap_addr);
+        auto const mmapEnd = (uint32_t) mmapStart + info->mmap_length;
         multiboot_memory_map_t *mmap;
-        for (mmap = (multiboot_memory_map_t *) info->mmap_addr;
-             (uint32_t) mmap < info->mmap_addr + info->mmap_length;
+        for (mmap = mmapStart;
+             (uint32_t) mmap < mmapEnd;
              mmap = (multiboot_memory_map_t * )((uint32_t) mmap + mmap->size + sizeof(mmap->size))) {
             printf("block: [%x-%x) (len: %x) type: %x\n", (unsigned int) mmap->addr, (unsigned int)(mmap->addr+mmap->len), (unsigned int) mmap->len,
                    (unsigned int) mmap->type);
@@ -5,6 +5,8 @@
 #include <arch/i386/mem/MMU.hpp>
 
 #include <arch/i386/mem/Paging.hpp>
+#include <arch/i386/mem/TlbBatch.hpp>
+#include <cpu/InterruptGuard.hpp>
 #include <system/asm.h>
 #include <mem/PageFrameAllocator.hpp>
 #include <mem/PageTable.hpp>
@@ -12,6 +14,7 @@
 
 #include <system/Debug.hpp>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <new>
@@ -19,10 +22,18 @@
 namespace {
 
 constexpr std::uint32_t const kVGAPage{0xB8000 / 0x1000};
-constexpr std::uint32_t const kPDESelfMapIndex{1023};
+/** The first page directory entry of the kernel half. */
+constexpr std::uint16_t const kKernelDirectoryIndex{X86::kKernelVirtualBase >> 22u};
 
-using X86PageTable = std::uint32_t[0x400];
-X86PageTable * const kPageDirectoryAddress = (X86PageTable *)(0xFFC00000);
+constexpr std::uint32_t const kCPUIDLargePages = 1u << 3;   ///< CPUID.1:EDX.PSE
+constexpr std::uint32_t const kCPUIDGlobalPages = 1u << 13; ///< CPUID.1:EDX.PGE
+constexpr std::uint32_t const kCR4LargePages = 1u << 4;     ///< CR4.PSE
+constexpr std::uint32_t const kCR4GlobalPages = 1u << 7;    ///< CR4.PGE
+constexpr std::uint32_t const kFramesPerLargePage{0x400};
+constexpr std::uint32_t const kPageFaultPresent = 0x1; ///< Page fault error code: the page was present.
+constexpr std::uint32_t const kPageFaultWrite = 0x2;   ///< Page fault error code: the access was a write.
+
+constexpr std::uint8_t const kAnonymousProtection = VirtualMemoryMap::kProtRead | VirtualMemoryMap::kProtWrite;
 
 }
 
@@ -37,10 +48,24 @@ extern uint32_t readonly_end;
 //==========================================================
 namespace {
 
-// Pulls the page table from the self-mapped page directory.
-// Trust me, you need to use this. Don't use the address from the page directory
-// entry. That's the physical page frame!
-PageTable PageTableForDirectoryIndex(uint32_t index) { return PageTable(kPageDirectoryAddress + index); }
+// Page directories and tables live in low memory, so whichever address space
+// they belong to, they can be edited through the direct map.
+PageTable DirectoryOf(AddressSpace addressSpace)
+{
+    return PageTable{X86::physicalToVirtual(std::uintptr_t(addressSpace.address()))};
+}
+
+// The page table a directory entry points to. Don't use the address in the
+// entry as is, that's the physical page frame!
+PageTable TableFor(PageEntry pde) { return PageTable{X86::physicalToVirtual(pde.address())}; }
+
+/** Checks CPUID leaf 1 for all of the given EDX feature bits. */
+bool cpu_has_features(std::uint32_t edxFeatures)
+{
+    std::uint32_t eax, edx;
+    cpuid(1, &eax, &edx);
+    return (edx & edxFeatures) == edxFeatures;
+}
 
 } // anonymous namespace
 
@@ -48,11 +73,132 @@ PageTable PageTableForDirectoryIndex(uint32_t index) { return PageTable(kPageDir
 // MMU Public Methods
 //===========================================================
 
-PageTable MMU::cloneDirectory(AddressSpace src)
+AddressSpace MMU::cloneDirectory(AddressSpace src)
+{
+    InterruptGuard guard;
+    auto const cloneFrame = frameCache().alloc();
+    AddressSpace clone{reinterpret_cast<std::uint32_t *>(cloneFrame)};
+    auto directory = DirectoryOf(src);
+    auto cloneDirectory = DirectoryOf(clone);
+
+    // Turns a writable user page into a copy-on-write one, shared by both spaces.
+    TlbBatch tlb;
+    auto const share = [&](PageEntry &entry, std::uintptr_t virtualAddress) {
+        _pageFrameAllocator.addReference(entry.address());
+        if (entry.getFlag(kReadWriteBit)) {
+            entry.unsetFlag(kReadWriteBit);
+            entry.setFlag(kCopyOnWriteBit);
+            tlb.add(virtualAddress);
+        }
+    };
+
+    for (auto const run : tablesFor(src, 0, X86::kKernelVirtualBase / kFrameSize)) {
+        auto pde = run.pde;
+        if (!run.present()) {
+            cloneDirectory.setEntry(run.directoryIndex, pde);
+            continue;
+        }
+
+        if (run.large()) {
+            share(pde, run.addressOf(0));
+            directory.setEntry(run.directoryIndex, pde);
+            cloneDirectory.setEntry(run.directoryIndex, pde);
+            continue;
+        }
+
+        // Each space needs its own copy of the table, but only of the table.
+        auto const tableFrame = frameCache().alloc();
+        PageTable table = run.table();
+        PageTable cloneTable{X86::physicalToVirtual(tableFrame)};
+        for (auto j = run.first; j < run.end; ++j) {
+            auto pte = table.entryAtIndex(j);
+            if (pte.getFlag(kPresentBit)) {
+                share(pte, run.addressOf(j));
+                table.setEntry(j, pte);
+            }
+            cloneTable.setEntry(j, pte);
+        }
+
+        cloneDirectory.setEntry(run.directoryIndex, PageEntry(tableFrame | pde.flags(), int{}));
+    }
+
+    // the kernel, which every space shares as is
+    for (auto i = kKernelDirectoryIndex; i < 0x400; ++i) {
+        cloneDirectory.setEntry(i, directory.entryAtIndex(i));
+    }
+
+    tlb.commit();
+
+    // the clone owns the same areas, including the parts not backed yet
+    auto const &maps = mapsFor(src);
+    auto &cloneMaps = newMaps(clone);
+    cloneMaps.ranges = maps.ranges;
+    cloneMaps.areas = maps.areas;
+
+    return clone;
+}
+
+AddressSpace MMU::create()
 {
-    void *page = palloc(src, 1);
-    std::memset(page, 0, X86::kPageTableSize);
-    return {page};
+    InterruptGuard guard;
+    auto const *unused = std::ranges::find_if(_addressSpaceMaps, [](auto const &entry) { return !entry.directory; });
+    if (unused == std::end(_addressSpaceMaps)) {
+        return AddressSpace{};
+    }
+
+    AddressSpace addressSpace{reinterpret_cast<std::uint32_t *>(takeTableFrame())};
+    auto directory = DirectoryOf(addressSpace);
+    directory.clear();
+
+    for (auto const &entry : _addressSpaceMaps) {
+        if (entry.directory != nullptr) {
+            auto const kernelDirectory = DirectoryOf(AddressSpace{static_cast<void *>(entry.directory)});
+            for (auto i = kKernelDirectoryIndex; i < 0x400; ++i) {
+                directory.setEntry(i, kernelDirectory.entryAtIndex(i));
+            }
+            break;
+        }
+    }
+
+    // from here on, changes to the kernel half reach this space too
+    mapsFor(addressSpace);
+    return addressSpace;
+}
+
+void MMU::destroy(AddressSpace addressSpace)
+{
+    InterruptGuard guard;
+    for (auto const run : tablesFor(addressSpace, 0, X86::kKernelVirtualBase / kFrameSize)) {
+        if (!run.present()) {
+            continue;
+        }
+
+        if (run.large()) {
+            if (_pageFrameAllocator.releaseReference(run.pde.address())) {
+                _pageFrameAllocator.free(run.pde.address(), kFramesPerLargePage);
+            }
+            continue;
+        }
+
+        // frames still shared copy-on-write stay with the other space
+        auto const table = run.table();
+        for (auto i = run.first; i < run.end; ++i) {
+            auto const pte = table.entryAtIndex(i);
+            if (pte.getFlag(kPresentBit) && _pageFrameAllocator.releaseReference(pte.address())) {
+                frameCache().free(pte.address());
+            }
+        }
+        frameCache().free(run.pde.address());
+    }
+
+    // the slot is reset when it is next handed out
+    for (auto &maps : _addressSpaceMaps) {
+        if (maps.directory == addressSpace.address()) {
+            maps.directory = nullptr;
+        }
+    }
+
+    frameCache().free(reinterpret_cast<PageFrame>(addressSpace.address()));
 }
 
 MMU::MMU(uint32_t mmap_addr, uint32_t mmap_length) : _pageFrameAllocator{}
@@ -65,219 +211,535 @@ MMU::MMU(uint32_t mmap_addr, uint32_t mmap_length) : _pageFrameAllocator{}
         _pageFrameAllocator.markFrameUsable(i, false);
     }
 
-    auto kernel_end_addr = (uint32_t)&kernel_end;
+    auto kernel_end_addr = std::uint32_t(X86::virtualToPhysical(&kernel_end));
 
-    for (; i <= kernel_end_addr; i += 0x1000) {
+    for (; i < kernel_end_addr; i += 0x1000) {
         if (!_pageFrameAllocator.requestFrame(i)) {
             kernel->panic("Page allocation error: unable to reserve kernel memory frames.");
         }
     }
+
+    _kernelMaps.ranges = VirtualRangeAllocator{X86::kKernelPagesStart, X86::kKernelPagesEnd};
 }
 
 void MMU::install(AddressSpace addressSpace)
 {
-    std::uint32_t readOnlyEnd = std::uint32_t(&readonly_end) / 0x1000;
-    addressSpace.clear();
+    std::uint32_t readOnlyEnd = std::uint32_t(X86::virtualToPhysical(&readonly_end)) / 0x1000;
+    auto directory = DirectoryOf(addressSpace);
+    directory.clear();
+
+    // map all the memory there is, as far as the direct map reaches
+    auto const directMapEnd = std::min<std::uint64_t>(_pageFrameAllocator.memoryEnd(), X86::kDirectMapSize);
+    std::uint32_t const directMapFrames = std::uint32_t(directMapEnd / 0x1000);
+
+    // The kernel half is the same in every address space, so if the CPU can
+    // keep its translations across CR3 reloads, let it.
+    _globalPages = cpu_has_features(kCPUIDGlobalPages);
+    _largePages = cpu_has_features(kCPUIDLargePages);
+    if (_largePages) {
+        write_cr4(read_cr4() | kCR4LargePages);
+    }
 
-    // identity map current used address space
-    std::uint32_t lastUsedFrame = readOnlyEnd;
-    uint32_t address = 0;
-    uint16_t tableDirectoryIndex = 0;
+    // Until the new directory is installed, tables are written through the
+    // boot mapping, which takeTableFrame() makes sure they are in.
+    auto const directMap = [&](std::uint32_t frame, bool writable) {
+        auto const directoryIndex = static_cast<uint16_t>(kKernelDirectoryIndex + frame / 0x400);
+        PageEntry pde = directory.entryAtIndex(directoryIndex);
+        if (!pde.getFlag(kPresentBit)) {
+            pde = PageEntry{takeTableFrame()};
+            pde.setFlags(kPresentBit | kReadWriteBit);
+            TableFor(pde).clear();
+            directory.setEntry(directoryIndex, pde);
+        }
 
-    auto const addToDirectory = [&](uint16_t i, PageTable t) {
-        // Install finished table
-        PageEntry entry((uint32_t)t.address());
+        PageEntry entry(frame * 0x1000);
         entry.setFlag(kPresentBit);
-        entry.setFlag(kReadWriteBit);
-        addressSpace.setEntry(i, entry);
+        if (writable) { entry.setFlag(kReadWriteBit); }
+        if (_globalPages) { entry.setFlag(kGlobalBit); }
+        TableFor(pde).setEntry(static_cast<uint16_t>(frame % 0x400), entry);
     };
 
-    auto const createNextTable = [&] {
-        PageTable newTable{_pageFrameAllocator.alloc(1)};
-        newTable.clear();
-        const auto tableFrameIndex = std::uint32_t(newTable.address()) / 0x1000;
-        lastUsedFrame = std::max(lastUsedFrame, tableFrameIndex);
-        return newTable;
+    // Map whole 4 MiB chunks past the read only data with a single large page
+    // each. The chunks holding read only data keep 4 KiB pages so that the
+    // protection stays page-granular, and so does a partial chunk at the end
+    // of memory, so that nothing past it is mapped.
+    auto const directMapLarge = [&](std::uint32_t frame) {
+        PageEntry entry(frame * 0x1000);
+        entry.setFlags(kPresentBit | kReadWriteBit | kPageSizeBit);
+        if (_globalPages) { entry.setFlag(kGlobalBit); }
+        directory.setEntry(static_cast<uint16_t>(kKernelDirectoryIndex + frame / kFramesPerLargePage), entry);
     };
 
-    PageTable table;
-    for (std::size_t frame = 0; frame <= lastUsedFrame; ++frame, address += 0x1000)
-    {
-        if (frame % 0x400 == 0) {
-            if (table) { addToDirectory(tableDirectoryIndex++, table); }
-            table = createNextTable();
+    std::uint32_t frame = 0;
+    while (frame < directMapFrames) {
+        if (_largePages && frame % kFramesPerLargePage == 0 && frame >= readOnlyEnd
+            && frame + kFramesPerLargePage <= directMapFrames) {
+            directMapLarge(frame);
+            frame += kFramesPerLargePage;
+        } else {
+            // make sure pages for read only data are marked read only
+            directMap(frame, frame >= readOnlyEnd || frame == kVGAPage);
+            ++frame;
         }
+    }
 
-        PageEntry entry(address);
-        entry.setFlag(kPresentBit);
-        // make sure pages for read only data are marked read only
-        if (frame > readOnlyEnd || frame == kVGAPage) {
-            entry.setFlag(kReadWriteBit);
-        }
+    // This drops the boot mapping, identity map and all. The kernel's own
+    // addresses stay valid, as the direct map covers the kernel image.
+    addressSpace.install();
+    _directMapped = true;
 
-        auto const index = static_cast<uint16_t>(frame % 0x400);
-        table.setEntry(index, entry);
+    if (_globalPages) {
+        write_cr4(read_cr4() | kCR4GlobalPages);
     }
+}
 
-    // install final one.
-    if (table) { addToDirectory(tableDirectoryIndex, table); }
+void *MMU::palloc(AddressSpace addressSpace, size_t numberOfPages, PageAllocFlag flags)
+{
+    InterruptGuard guard;
+    auto const address = claimRange(_kernelMaps, 0, numberOfPages, 1, {.protection = kAnonymousProtection});
+    if (!address) {
+        return nullptr;
+    }
 
-    // Set last PDE to PD itself
-    addToDirectory(kPDESelfMapIndex, addressSpace);
-    addressSpace.install();
+    auto retval = reinterpret_cast<void *>(address);
+    allocatePages(addressSpace, retval, numberOfPages, flags);
+    return retval;
+}
+
+void *MMU::palloc(AddressSpace addressSpace, void *virtualAddress, size_t numberOfPages, PageAllocFlag flags)
+{
+    InterruptGuard guard;
+    auto address = reinterpret_cast<uintptr_t>(virtualAddress);
+    if (address & 0xFFF) {
+        return nullptr; // address is not page aligned
+    }
+
+    auto &maps = mapsFor(addressSpace, address);
+    if (!claimRange(maps, address, numberOfPages, 1, {.protection = kAnonymousProtection})) {
+        return nullptr; // can't allocate, not enough space
+    }
+
+    allocatePages(addressSpace, virtualAddress, numberOfPages, flags);
+    return virtualAddress;
 }
 
-void *MMU::palloc(AddressSpace addressSpace, size_t numberOfPages)
+int MMU::pfree(AddressSpace addressSpace, void *startOfMemoryRange, size_t numberOfPages)
 {
-    size_t contiguousFoundPages = 0;
-    uintptr_t retpde = 0, retpte = 0;
-    void *retval = nullptr;
-    for (uint16_t pde = 0; pde < 1024 && contiguousFoundPages != numberOfPages; ++pde) {
-        PageTable table = getOrCreateTable(addressSpace, pde);
-
-        // look through page table
-        for (uint16_t pte = 0; pte < 1024; ++pte) {
-            PageEntry entry = table.entryAtIndex(pte);
-            if (!entry.getFlag(kPresentBit)) { // found a page that isn't present (is available)
-                if (contiguousFoundPages == 0) { // this is the first available page, set our return pointer to it
-                    retpde = pde;
-                    retpte = pte;
-                }
-
-                ++contiguousFoundPages;
-                if (contiguousFoundPages == numberOfPages) { // done
-                    retval = (void *) ((retpde << 22u) | (retpte << 12u));
-                    break;
-                }
-            } else if (contiguousFoundPages) { // current page is used, reset our contiguous page count
-                retval = nullptr;
-                contiguousFoundPages = 0;
+    InterruptGuard guard;
+    uint32_t virtualAddress = (uint32_t) startOfMemoryRange;
+
+    if (!numberOfPages) return -1;
+
+    // large pages must be freed with pfreeLarge
+    for (auto const run : tablesFor(addressSpace, virtualAddress, numberOfPages)) {
+        if (run.present() && run.large()) {
+            return -1;
+        }
+    }
+
+    if (!releaseRange(mapsFor(addressSpace, virtualAddress), virtualAddress, numberOfPages)) {
+        return -1; // not all of it is mapped, or the maps are too fragmented to record the hole
+    }
+
+    TlbBatch tlb;
+    for (auto const run : tablesFor(addressSpace, virtualAddress, numberOfPages)) {
+        // demand paged areas may never have had a page table
+        if (!run.present()) {
+            continue;
+        }
+
+        auto table = run.table();
+        for (auto i = run.first; i < run.end; ++i) {
+            PageEntry pte = table.entryAtIndex(i);
+            if (!pte.getFlag(kPresentBit)) {
+                continue;
+            }
+
+            if (_pageFrameAllocator.releaseReference(pte.address())) {
+                frameCache().free(pte.address());
             }
+            table.setEntry(i, PageEntry(0));
+            tlb.add(run.addressOf(i), pte.getFlag(kGlobalBit));
         }
     }
 
-    if (retval) { // if we succeeded in finding space
-        allocatePages(addressSpace, retval, numberOfPages);
+    tlb.commit();
+
+    return 0;
+}
+
+int MMU::unmap(AddressSpace addressSpace, void *startOfArea, size_t numberOfPages)
+{
+    InterruptGuard guard;
+    auto const address = reinterpret_cast<std::uintptr_t>(startOfArea);
+    auto const *area = mapsFor(addressSpace, address).areas.find(address);
+    if (!area || numberOfPages == 0) {
+        return -1;
     }
 
-    return retval;
+    if (area->flags & VirtualMemoryMap::kAreaLargePages) {
+        if (numberOfPages % kFramesPerLargePage) {
+            return -1;
+        }
+        return pfreeLarge(addressSpace, startOfArea, numberOfPages / kFramesPerLargePage);
+    }
+
+    return pfree(addressSpace, startOfArea, numberOfPages);
 }
 
-void *MMU::palloc(AddressSpace addressSpace, void *virtualAddress, size_t numberOfPages)
+bool MMU::isMapped(AddressSpace addressSpace, void *startOfMemoryRange, size_t numberOfPages, std::uint8_t flags)
 {
-    auto address = reinterpret_cast<uintptr_t>(virtualAddress);
-    if (address & 0xFFF) {
+    InterruptGuard guard;
+    auto const address = reinterpret_cast<std::uintptr_t>(startOfMemoryRange);
+    return mapsFor(addressSpace, address).areas.covers(address, address + numberOfPages * kFrameSize, flags);
+}
+
+void *MMU::pallocLazy(AddressSpace addressSpace, VirtualMemoryMap::Area area)
+{
+    InterruptGuard guard;
+    if ((area.start & 0xFFF) || area.end <= area.start) {
         return nullptr; // address is not page aligned
     }
 
-    for (size_t i = 0; i < numberOfPages; ++i) {
-        auto page = pageForAddress(addressSpace, reinterpret_cast<void*>(address));
-        if (page.getFlag(kPresentBit)) {
-            virtualAddress = nullptr; // can't allocate, not enough space
-            break;
-        }
+    if (X86::isKernelAddress(area.end - 1)) {
+        return nullptr; // not in user space
+    }
 
-        address += 0x1000; // increment to next page
+    area.flags |= VirtualMemoryMap::kAreaDemandPaged;
+    auto const pages = (area.end - area.start + kFrameSize - 1) / kFrameSize;
+    return reinterpret_cast<void *>(claimRange(mapsFor(addressSpace), area.start, pages, 1, area));
+}
+
+bool MMU::handlePageFault(AddressSpace addressSpace, std::uintptr_t faultAddress, std::uint32_t errorCode)
+{
+    InterruptGuard guard;
+    auto const *area = mapsFor(addressSpace, faultAddress).areas.find(faultAddress);
+    if (!area) {
+        return false;
     }
 
-    if (virtualAddress) {
-        allocatePages(addressSpace, virtualAddress, numberOfPages);
+    // a protection fault means the page is already there; only a write to a
+    // copy-on-write page is expected
+    if (errorCode & kPageFaultPresent) {
+        return (errorCode & kPageFaultWrite) && (area->protection & VirtualMemoryMap::kProtWrite)
+               && copyOnWrite(addressSpace, faultAddress);
     }
 
-    return virtualAddress;
+    if (!(area->flags & VirtualMemoryMap::kAreaDemandPaged)) {
+        return false;
+    }
+
+    auto const page = faultAddress & k4KPageAddressMask;
+    allocatePages(addressSpace, reinterpret_cast<void *>(page), 1, kPageAllocZeroed);
+
+    std::size_t size = 0;
+    if (auto const *data = area->dataFor(page, &size)) {
+        std::memcpy(reinterpret_cast<void *>(page), data, size);
+    }
+
+    // filled in, so now it can lose write access if it shouldn't have it
+    if (!(area->protection & VirtualMemoryMap::kProtWrite)) {
+        auto table = TableFor(DirectoryOf(addressSpace).entryAtIndex(uint16_t(page >> 22u)));
+        auto pte = table.entryAtIndex(uint16_t(page >> 12u & 0x03FFu));
+        pte.unsetFlag(kReadWriteBit);
+        table.setEntry(uint16_t(page >> 12u & 0x03FFu), pte);
+        invlpg(page);
+    }
+
+    return true;
 }
 
-int MMU::pfree([[maybe_unused]] AddressSpace addressSpace, void *startOfMemoryRange, size_t numberOfPages)
+void *MMU::pallocLarge(AddressSpace addressSpace, size_t numberOfLargePages)
 {
-    uint32_t virtualAddress = (uint32_t) startOfMemoryRange;
+    InterruptGuard guard;
+    if (!_largePages) {
+        return palloc(addressSpace, numberOfLargePages * kFramesPerLargePage);
+    }
 
-    if (!numberOfPages) return -1;
+    auto const address = claimRange(_kernelMaps, 0, numberOfLargePages * kFramesPerLargePage, kFramesPerLargePage,
+                                    {.protection = kAnonymousProtection, .flags = VirtualMemoryMap::kAreaLargePages});
+    if (!address) {
+        return nullptr;
+    }
+
+    auto const directory = DirectoryOf(addressSpace);
+    TlbBatch tlb;
+    for (size_t i = 0; i < numberOfLargePages; ++i) {
+        auto const frame = _pageFrameAllocator.tryAlloc(kFramesPerLargePage, PageFrameAllocator::Zone::kNormal);
+        if (frame == kNoFrame) {
+            // not enough contiguous memory left; undo what we've done so far
+            tlb.commit();
+            if (i) { pfreeLarge(addressSpace, reinterpret_cast<void *>(address), i); }
+            releaseRange(_kernelMaps, address + i * kLargePageSize, (numberOfLargePages - i) * kFramesPerLargePage);
+            return nullptr;
+        }
 
-    while (numberOfPages--) {
-        uint32_t pdeIndex = virtualAddress >> 22u;
-        uint16_t pteIndex = virtualAddress >> 12u & 0x03FF;
-        PageTable table = PageTableForDirectoryIndex(pdeIndex);
-        PageEntry pte = table.entryAtIndex(pteIndex);
-        _pageFrameAllocator.free(pte.address());
-        table.setEntry(pteIndex, PageEntry(0));
+        // Since the whole range was free, any page table here is an empty one
+        // left behind by earlier 4 KiB mappings.
+        auto const directoryIndex = uint16_t((address >> 22u) + i);
+        if (auto const pde = directory.entryAtIndex(directoryIndex); pde.getFlag(kPresentBit)) {
+            frameCache().free(pde.address());
+            tlb.add(std::uintptr_t(directoryIndex) << 22u);
+        }
 
-        virtualAddress += 0x1000;
+        PageEntry entry{frame};
+        entry.setFlags(kPresentBit | kReadWriteBit | kPageSizeBit);
+        if (_globalPages) { entry.setFlag(kGlobalBit); }
+        setDirectoryEntry(addressSpace, directoryIndex, entry);
     }
 
-    _flush();
+    return reinterpret_cast<void *>(address);
+}
+
+int MMU::pfreeLarge(AddressSpace addressSpace, void *startOfMemoryRange, size_t numberOfLargePages)
+{
+    InterruptGuard guard;
+    if (!_largePages) {
+        return pfree(addressSpace, startOfMemoryRange, numberOfLargePages * kFramesPerLargePage);
+    }
+
+    auto const address = reinterpret_cast<std::uintptr_t>(startOfMemoryRange);
+    if (!numberOfLargePages || (address & ~k4MPageAddressMask)) {
+        return -1;
+    }
+
+    auto const directory = DirectoryOf(addressSpace);
+    for (size_t i = 0; i < numberOfLargePages; ++i) {
+        auto const pde = directory.entryAtIndex(uint16_t((address >> 22u) + i));
+        if (!pde.getFlag(kPresentBit) || !pde.getFlag(kPageSizeBit)) {
+            return -1;
+        }
+    }
+
+    if (!releaseRange(mapsFor(addressSpace, address), address, numberOfLargePages * kFramesPerLargePage)) {
+        return -1;
+    }
+
+    TlbBatch tlb;
+    for (size_t i = 0; i < numberOfLargePages; ++i) {
+        auto const directoryIndex = uint16_t((address >> 22u) + i);
+        auto const pde = directory.entryAtIndex(directoryIndex);
+        if (_pageFrameAllocator.releaseReference(pde.address())) {
+            _pageFrameAllocator.free(pde.address(), kFramesPerLargePage);
+        }
+        setDirectoryEntry(addressSpace, directoryIndex, PageEntry(0));
+        tlb.add(std::uintptr_t(directoryIndex) << 22u, pde.getFlag(kGlobalBit));
+    }
 
     return 0;
 }
 
+bool MMU::prepareZeroedFrame()
+{
+    InterruptGuard guard;
+    if (_zeroedCount == kZeroedPoolSize) {
+        return false;
+    }
+
+    // don't hoard the last free frames just to have them cleared
+    if (_frameCache.size() == 0 && _pageFrameAllocator.freeFrames() < 2 * FrameCache::kBatch) {
+        return false;
+    }
+
+    auto const frame = frameCache().alloc();
+    std::memset(X86::physicalToVirtual(frame), 0, kFrameSize);
+
+    _zeroedFrames[_zeroedCount++] = frame;
+    return true;
+}
+
 //===========================================================
 // MMU Private methods
 //===========================================================
 
-PageTable MMU::getOrCreateTable(AddressSpace addressSpace, uint16_t directoryIndex)
+MMU::FreshFrame MMU::takeFrame(PageAllocFlag flags)
 {
-    if (directoryIndex > 1023) {
-        kernel->panic("MMU::getOrCreateTable: invalid directoryIndex");
+    if ((flags & kPageAllocZeroed) && _zeroedCount > 0) {
+        return {_zeroedFrames[--_zeroedCount], true};
     }
 
-    PageEntry pde = addressSpace.entryAtIndex(directoryIndex);
-    PageTable table{PageTableForDirectoryIndex(directoryIndex)};
-    if (!pde.getFlag(kPresentBit)) { // no page table here, create one
-        pde = PageEntry(_pageFrameAllocator.alloc(1));
-        pde.setFlags(kPresentBit | kReadWriteBit);
-        addressSpace.setEntry(directoryIndex, pde);
-        table.clear();
-        _flush();
+    return {frameCache().alloc(), false};
+}
+
+PageFrame MMU::takeTableFrame()
+{
+    return _directMapped ? frameCache().alloc() : _pageFrameAllocator.alloc(1, PageFrameAllocator::Zone::kDMA);
+}
+
+bool MMU::copyOnWrite(AddressSpace addressSpace, std::uintptr_t faultAddress)
+{
+    auto const directoryIndex = uint16_t(faultAddress >> 22u);
+    auto directory = DirectoryOf(addressSpace);
+    auto pde = directory.entryAtIndex(directoryIndex);
+    if (pde.getFlag(kPageSizeBit)) {
+        if (!pde.getFlag(kCopyOnWriteBit)) { return false; }
+
+        auto const base = faultAddress & k4MPageAddressMask;
+        if (_pageFrameAllocator.isShared(pde.address())) {
+            auto const frame = _pageFrameAllocator.tryAlloc(kFramesPerLargePage, PageFrameAllocator::Zone::kNormal);
+            if (frame == kNoFrame) { return false; }
+
+            std::memcpy(X86::physicalToVirtual(frame), reinterpret_cast<void const *>(base), kLargePageSize);
+            _pageFrameAllocator.releaseReference(pde.address());
+            pde = PageEntry(frame | pde.flags(), int{});
+        }
+
+        pde.unsetFlag(kCopyOnWriteBit);
+        pde.setFlag(kReadWriteBit);
+        directory.setEntry(directoryIndex, pde);
+        invlpg(base);
+        return true;
+    }
+
+    auto table = TableFor(pde);
+    auto const tableIndex = uint16_t(faultAddress >> 12u & 0x03FFu);
+    auto pte = table.entryAtIndex(tableIndex);
+    if (!pte.getFlag(kCopyOnWriteBit)) { return false; }
+
+    // the last space still holding the frame can just have it back
+    auto const page = faultAddress & k4KPageAddressMask;
+    if (_pageFrameAllocator.isShared(pte.address())) {
+        auto const frame = frameCache().alloc();
+        std::memcpy(X86::physicalToVirtual(frame), reinterpret_cast<void const *>(page), kFrameSize);
+        _pageFrameAllocator.releaseReference(pte.address());
+        pte = PageEntry(frame | pte.flags(), int{});
     }
 
-    return table;
+    pte.unsetFlag(kCopyOnWriteBit);
+    pte.setFlag(kReadWriteBit);
+    table.setEntry(tableIndex, pte);
+    invlpg(page);
+    return true;
 }
 
-PageTable MMU::tableForAddress(AddressSpace addressSpace, void *virtualAddress)
+void MMU::setDirectoryEntry(AddressSpace addressSpace, std::uint16_t directoryIndex, PageEntry entry)
 {
-    auto address = reinterpret_cast<uintptr_t>(virtualAddress);
-    auto pdeIndex = uint16_t(address >> 22u);
-    return getOrCreateTable(addressSpace, pdeIndex);
+    DirectoryOf(addressSpace).setEntry(directoryIndex, entry);
+    if (directoryIndex < kKernelDirectoryIndex) {
+        return;
+    }
+
+    for (auto const &maps : _addressSpaceMaps) {
+        if (maps.directory) {
+            DirectoryOf(AddressSpace{maps.directory}).setEntry(directoryIndex, entry);
+        }
+    }
+}
+
+MMU::AddressSpaceMaps &MMU::mapsFor(AddressSpace addressSpace)
+{
+    for (auto &entry : _addressSpaceMaps) {
+        if (entry.directory == addressSpace.address()) {
+            return entry;
+        }
+    }
+
+    auto &maps = newMaps(addressSpace);
+    maps.ranges = VirtualRangeAllocator{X86::kUserSpaceStart, X86::kKernelVirtualBase};
+    maps.areas = VirtualMemoryMap{};
+    return maps;
 }
 
-PageEntry MMU::pageForAddress(AddressSpace addressSpace, void *virtualAddress)
+MMU::AddressSpaceMaps &MMU::newMaps(AddressSpace addressSpace)
 {
-    auto table = tableForAddress(addressSpace, virtualAddress);
-    uintptr_t address = reinterpret_cast<uintptr_t>(virtualAddress);
-    uint16_t pteIndex = address >> 12u & 0x03FFu;
-    return table.entryAtIndex(pteIndex);
+    auto *unused = std::ranges::find_if(_addressSpaceMaps, [](auto const &entry) { return !entry.directory; });
+    if (unused == std::end(_addressSpaceMaps)) {
+        kernel->panic("MMU: too many address spaces.");
+    }
+
+    unused->directory = addressSpace.address();
+    return *unused;
 }
 
+MMU::AddressSpaceMaps &MMU::mapsFor(AddressSpace addressSpace, std::uintptr_t address)
+{
+    return X86::isKernelAddress(address) ? _kernelMaps : mapsFor(addressSpace);
+}
 
-void MMU::allocatePages([[maybe_unused]] AddressSpace addressSpace, void *address, size_t numberOfPages)
+std::uintptr_t MMU::claimRange(AddressSpaceMaps &maps, std::uintptr_t address, std::size_t numberOfPages,
+                               std::size_t alignment, VirtualMemoryMap::Area area)
 {
-    auto virtualAddress = reinterpret_cast<uintptr_t>(address);
-    uint32_t currpde = virtualAddress >> 22u;
-    uint16_t currpte = virtualAddress >> 12u & 0x03FFu;
-    size_t pagesLeft = numberOfPages;
-    while (pagesLeft > 0) { // map the pages
-        PageTable table = PageTableForDirectoryIndex(currpde);
-        PageEntry entry{_pageFrameAllocator.alloc(1)};
-        entry.setFlags(kPresentBit | kReadWriteBit);
-        table.setEntry(currpte, entry);
-
-        ++currpte;
-        --pagesLeft;
-
-        // move to next PDE if needed
-        if (currpte > 1023) {
-            ++currpde;
-            currpte = 0;
-        }
+    if (address) {
+        if (!maps.ranges.reserve(address, numberOfPages)) { return 0; }
+    } else if (address = maps.ranges.allocate(numberOfPages, alignment); !address) {
+        return 0;
     }
 
-    _flush();
+    area.start = address;
+    area.end = address + numberOfPages * kFrameSize;
+    if (!maps.areas.insert(area)) {
+        maps.ranges.release(address, numberOfPages);
+        return 0;
+    }
+
+    return address;
 }
 
-void MMU::_flush()
+bool MMU::releaseRange(AddressSpaceMaps &maps, std::uintptr_t address, std::size_t numberOfPages)
 {
-    asm volatile(
-            "movl %cr3, %eax;"
-            "movl %eax, %cr3"
-            );
+    if (!maps.areas.covers(address, address + numberOfPages * kFrameSize)) {
+        return false; // only what was handed out can be given back
+    }
+
+    if (!maps.ranges.release(address, numberOfPages)) {
+        return false;
+    }
+
+    if (!maps.areas.remove(address, address + numberOfPages * kFrameSize)) {
+        // taking back what was just given back always fits
+        maps.ranges.reserve(address, numberOfPages);
+        return false;
+    }
+
+    return true;
 }
 
+PageTable MMU::getOrCreateTable(AddressSpace addressSpace, uint16_t directoryIndex)
+{
+    if (directoryIndex > 1023) {
+        kernel->panic("MMU::getOrCreateTable: invalid directoryIndex");
+    }
+
+    PageEntry pde = DirectoryOf(addressSpace).entryAtIndex(directoryIndex);
+    if (!pde.getFlag(kPresentBit)) { // no page table here, create one
+        auto const fresh = takeFrame(kPageAllocZeroed);
+        if (!fresh.zeroed) { std::memset(X86::physicalToVirtual(fresh.frame), 0, kFrameSize); }
+        pde = PageEntry(fresh.frame);
+        pde.setFlags(kPresentBit | kReadWriteBit);
+        setDirectoryEntry(addressSpace, directoryIndex, pde);
+    }
+
+    return TableFor(pde);
+}
+
+X86::PageTableRange MMU::tablesFor(AddressSpace addressSpace, std::uintptr_t address, std::size_t numberOfPages)
+{
+    return X86::PageTableRange{DirectoryOf(addressSpace), address, numberOfPages};
+}
+
+void MMU::allocatePages(AddressSpace addressSpace, void *address, size_t numberOfPages,
+                        PageAllocFlag flags)
+{
+    auto virtualAddress = reinterpret_cast<uintptr_t>(address);
+    bool const global = _globalPages && X86::isKernelAddress(virtualAddress);
+    for (auto const run : tablesFor(addressSpace, virtualAddress, numberOfPages)) {
+        // one lookup (or new table) for up to 1024 pages
+        PageTable table = getOrCreateTable(addressSpace, run.directoryIndex);
+        for (auto i = run.first; i < run.end; ++i) { // map the pages
+            auto const fresh = takeFrame(flags);
+
+            // the pool ran dry, so clear the frame before it's mapped
+            if ((flags & kPageAllocZeroed) && !fresh.zeroed) {
+                std::memset(X86::physicalToVirtual(fresh.frame), 0, kFrameSize);
+            }
+
+            PageEntry entry{fresh.frame};
+            entry.setFlags(kPresentBit | kReadWriteBit);
+            if (global) { entry.setFlag(kGlobalBit); }
+            table.setEntry(i, entry);
+        }
+    }
+
+    // Nothing to invalidate: these pages weren't present before, so the TLB
+    // can't be holding translations for them.
+}
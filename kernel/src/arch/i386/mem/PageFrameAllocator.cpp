@@ -4,47 +4,207 @@
 
 #include <mem/PageFrameAllocator.hpp>
 #include <arch/i386/cpu/multiboot.h>
+#include <arch/i386/mem/DirectMap.hpp>
 #include <Kernel.hpp>
 
 #include <io/Print.hpp>
+#include <mem/Units.hpp>
 
 #include <cstdio>
 #include <cstring>
 
 using namespace sys::literals;
+using namespace sys::mem_unit_literals;
+
+//==========================================================
+// Externs
+//==========================================================
+extern uint32_t kernel_end;
 
 namespace {
 
+using FrameDescriptor = PageFrameAllocator::FrameDescriptor;
+
 constexpr auto frame_to_index(PageFrame frame) { return (frame & k4KPageAddressMask) / 0x1000; }
 constexpr PageFrame index_to_frame(uint32_t index) { return index * 0x1000; }
 
+constexpr std::uint32_t block_size(std::uint32_t order) { return 1u << order; }
+
+// Zone boundaries, in frames. Both are aligned well past any block that could
+// straddle them, so blocks never span two zones. High memory is whatever the
+// kernel's direct map doesn't reach.
+constexpr std::uint32_t kNormalZoneStart = 16_MiB / 0x1000;
+constexpr std::uint32_t kHighZoneStart = X86::kDirectMapSize / 0x1000;
+
+constexpr std::uint32_t zone_end(PageFrameAllocator::Zone zone)
+{
+    switch (zone) {
+        case PageFrameAllocator::Zone::kDMA: return kNormalZoneStart;
+        case PageFrameAllocator::Zone::kNormal: return kHighZoneStart;
+        default: return kPagesInBitmap;
+    }
+}
+
+constexpr PageFrameAllocator::Zone zone_for_index(std::uint32_t index)
+{
+    return index < kNormalZoneStart ? PageFrameAllocator::Zone::kDMA
+                                    : index < kHighZoneStart ? PageFrameAllocator::Zone::kNormal
+                                                             : PageFrameAllocator::Zone::kHigh;
+}
+
+/** The largest order a block starting at `index` may have without breaking alignment. */
+constexpr std::uint32_t alignment_order(std::uint32_t index)
+{
+    return index ? std::min(std::uint32_t(__builtin_ctz(index)), PageFrameAllocator::kMaxOrder)
+                 : PageFrameAllocator::kMaxOrder;
+}
+
+/** floor(log2(count)), count > 0 */
+constexpr std::uint32_t floor_order(std::uint32_t count) { return 31u - std::uint32_t(__builtin_clz(count)); }
+
+/** ceil(log2(count)), count > 0 */
+constexpr std::uint32_t ceil_order(std::uint32_t count)
+{
+    return count == 1 ? 0 : floor_order(count - 1) + 1;
+}
+
 multiboot_memory_map_t * next(multiboot_memory_map_t *mmap)
 {
     return reinterpret_cast<multiboot_memory_map_t *>(uint32_t(mmap) + mmap->size + sizeof(mmap->size));
 }
 
+/**
+ * Calls `fn(start, end)` for each maximal run of bits equal to `value` within
+ * [first, last), skipping over the other bits a word at a time.
+ */
+template <typename Fn>
+void for_each_run(sys::BitSet<kPagesInBitmap> const &bits, bool value, std::uint32_t first, std::uint32_t last, Fn &&fn)
+{
+    auto const findValue = [&](std::uint32_t from) {
+        return std::uint32_t(std::min<std::size_t>(value ? bits.findFirstSet(from) : bits.findFirstClear(from), last));
+    };
+    auto const findOther = [&](std::uint32_t from) {
+        return std::uint32_t(std::min<std::size_t>(value ? bits.findFirstClear(from) : bits.findFirstSet(from), last));
+    };
+
+    for (auto start = findValue(first); start < last; start = findValue(start)) {
+        auto const end = findOther(start);
+        fn(start, end);
+        start = end;
+    }
 }
 
-void PageFrameAllocator::Bitmap::loadMemoryMap(uint32_t mmapAddr, uint32_t mmapLength)
+template <typename Fn>
+void for_each_usable_range(uint32_t mmapAddr, uint32_t mmapLength, Fn &&fn)
 {
+    auto const end = (multiboot_memory_map_t *)(mmapAddr + mmapLength);
+    for (auto *mmap = (multiboot_memory_map_t *)mmapAddr; mmap < end; mmap = next(mmap))
+    {
+        if (mmap->type != MULTIBOOT_MEMORY_AVAILABLE) { continue; }
+
+        uint64_t const firstPage = mmap->addr / 0x1000;
+        uint64_t const lastPage = std::min<uint64_t>((mmap->addr + mmap->len) / 0x1000, kPagesInBitmap);
+        if (firstPage < lastPage) {
+            fn(std::uint32_t(firstPage), std::uint32_t(lastPage));
+        }
+    }
+}
+
+}
+
+void PageFrameAllocator::loadMemoryMap(uint32_t mmapPhysicalAddr, uint32_t mmapLength)
+{
+    // the bootloader hands out physical addresses
+    auto const mmapAddr = std::uint32_t(X86::physicalToVirtual<>(mmapPhysicalAddr));
     auto const end = (multiboot_memory_map_t *)(mmapAddr + mmapLength);
     for (auto *mmap = (multiboot_memory_map_t *)mmapAddr; mmap < end; mmap = next(mmap))
     {
         uint64_t page_offset = mmap->addr / 0x1000;
         uint64_t num_pages = mmap->len / 0x1000;
         sys::print("page_offset=%@,num_pages=%@\n", page_offset, num_pages);
-        if (mmap->type == 1) {
-            for (auto i = std::size_t(page_offset); i < page_offset + num_pages; ++i) {
-                usable[i] = true;
-            }
+    }
+
+    // mark the usable frames and size the descriptor array to the highest one
+    _frameCount = 0;
+    for_each_usable_range(mmapAddr, mmapLength, [this](std::uint32_t first, std::uint32_t last) {
+        _free.setRange(first, last - first);
+        _frameCount = std::max(_frameCount, last);
+    });
+    _usage.freeFrames = _free.count();
+
+    // ...and put the descriptors directly behind the kernel image. Only what
+    // boot.s mapped is reachable yet, so they have to fit in there.
+    auto const descriptorStart = sys::div_ceil(std::uint32_t(X86::virtualToPhysical(&kernel_end)), kFrameSize);
+    auto const descriptorFrames = sys::div_ceil(_frameCount * sizeof(FrameDescriptor), kFrameSize);
+    if (index_to_frame(descriptorStart + descriptorFrames) > X86::kBootMapSize) {
+        kernel->panic("Page allocation error: page frame descriptors don't fit in the boot mapping.");
+    }
+    for (auto i = descriptorStart; i < descriptorStart + descriptorFrames; ++i) {
+        if (!requestFrameIndex(i)) {
+            kernel->panic("Page allocation error: no room for page frame descriptors behind the kernel.");
         }
     }
+    _frames = X86::physicalToVirtual<FrameDescriptor>(index_to_frame(descriptorStart));
+    _bootstrapEnd = index_to_frame(descriptorStart + descriptorFrames);
+    std::memset(_frames, 0, _frameCount * sizeof(FrameDescriptor));
+    for (auto &zone : _zones) { zone = ZoneState{}; }
+
+    // everything below the highest usable frame that isn't free now is a hole in
+    // the memory map, apart from the descriptors themselves
+    for_each_run(_free, false, 0, _frameCount, [this, descriptorStart, descriptorFrames](std::uint32_t start, std::uint32_t runEnd) {
+        for (auto i = start; i < runEnd; ++i) {
+            if (i < descriptorStart || i >= descriptorStart + descriptorFrames) {
+                _frames[i].flags = FrameDescriptor::kReserved;
+            }
+        }
+    });
+    _usage.reservedFrames = _frameCount - _usage.freeFrames - _usage.usedFrames;
+
+    // hand the free frames over to the buddy lists
+    for_each_run(_free, true, 0, _frameCount, [this](std::uint32_t start, std::uint32_t runEnd) {
+        freeRun(start, runEnd - start);
+    });
+
+    // Hold back part of each lower zone from allocations that fall back to it:
+    // up to 4 MiB of DMA memory for I/O buffers, and 1/32 of normal memory.
+    auto &dma = zoneState(Zone::kDMA);
+    dma.watermark = std::min<std::size_t>(dma.freeFrames / 2, 4_MiB / kFrameSize);
+    auto &normal = zoneState(Zone::kNormal);
+    normal.watermark = normal.freeFrames / 32;
+}
+
+PageFrameAllocator::Zone PageFrameAllocator::zoneOf(PageFrame frame)
+{
+    return zone_for_index(std::uint32_t(frame_to_index(frame)));
 }
 
 void PageFrameAllocator::markFrameUsable(PageFrame frame, bool usable)
 {
     uint32_t const frameNumber = frame_to_index(frame);
-    _bitmap.usable[frameNumber] = usable;
+    if (frameNumber >= _frameCount || isReserved(frameNumber) != usable) {
+        return;
+    }
+
+    auto &desc = _frames[frameNumber];
+    if (usable) {
+        desc.flags &= std::uint8_t(~FrameDescriptor::kReserved);
+        --_usage.reservedFrames;
+        ++_usage.freeFrames;
+        _free.set(frameNumber);
+        freeRun(frameNumber, 1);
+    } else {
+        // a frame that is handed out stays with its owner, but won't come back
+        if (_free.test(frameNumber)) {
+            carveFrame(frameNumber);
+            _free.unset(frameNumber);
+            --_usage.freeFrames;
+        } else {
+            --_usage.usedFrames;
+        }
+
+        desc.flags |= FrameDescriptor::kReserved;
+        ++_usage.reservedFrames;
+    }
 }
 
 bool PageFrameAllocator::requestFrame(PageFrame frame)
@@ -55,66 +215,278 @@ bool PageFrameAllocator::requestFrame(PageFrame frame)
 
 bool PageFrameAllocator::requestFrameIndex(std::size_t index)
 {
-    bool retval = _bitmap.usableAndFree(index);
+    bool retval = index < _frameCount && _free.test(index);
     if (retval) {
-        _bitmap.used[index] = true;
+        // before the descriptors exist, nothing is on the free lists yet
+        if (_frames && !carveFrame(index)) {
+            return false;
+        }
+        _free.unset(index);
+        --_usage.freeFrames;
+        ++_usage.usedFrames;
     }
 
     return retval;
 }
 
-PageFrame PageFrameAllocator::alloc(std::size_t numberOfFrames)
+PageFrame PageFrameAllocator::alloc(std::size_t numberOfFrames, Zone zone)
 {
-    if (numberOfFrames == 0) { return std::numeric_limits<PageFrame>::max(); }
+    auto const frame = tryAlloc(numberOfFrames, zone);
+    if (frame == kNoFrame && numberOfFrames != 0) {
+        // out of memory
+        kernel->panic("Unable to allocate page frame. Out of memory.");
+        return 0;
+    }
 
-    uint32_t const startIndex = frame_to_index(_lastAllocFrame);
+    return frame;
+}
 
-    auto const findFrames = [=, this](uint32_t i) -> sys::Maybe<PageFrame> {
-        // printf("checking bitmap idx %d\n", i);
-        bool found = true;
-        for (auto offset = 0_sz; offset < numberOfFrames; ++offset) {
-            found &= _bitmap.usableAndFree(i + offset);
-        }
+PageFrame PageFrameAllocator::tryAlloc(std::size_t numberOfFrames, Zone zone)
+{
+    if (numberOfFrames == 0) { return kNoFrame; }
 
-        if (found) {
-            // puts("got 'em");
-            PageFrame const result = index_to_frame(i);
-            for (auto offset = 0_sz; offset < numberOfFrames; ++offset) {
-                _bitmap.used[i + offset] = true;
+    auto const order = numberOfFrames > block_size(kMaxOrder) ? kMaxOrder + 1
+                                                              : ceil_order(std::uint32_t(numberOfFrames));
+
+    // dip into the lower zones' reserves before giving up altogether
+    auto *state = findZone(zone, order, true);
+    if (!state) { state = findZone(zone, order, false); }
+    if (!state) {
+        return kNoFrame;
+    }
+
+    return index_to_frame(takeFrames(*state, order, std::uint32_t(numberOfFrames)));
+}
+
+void PageFrameAllocator::free(PageFrame frame, std::size_t numberOfFrames)
+{
+    auto const index = frame_to_index(frame);
+    auto const end = std::min<std::uint32_t>(std::uint32_t(index + numberOfFrames), _frameCount);
+
+    // only frames which are actually handed out go back; anything else (e.g.
+    // reserved frames or a double free) is left alone
+    for_each_run(_free, false, index, end, [this](std::uint32_t usedStart, std::uint32_t usedEnd) {
+        std::uint32_t runStart = usedStart;
+        for (auto i = usedStart; i <= usedEnd; ++i) {
+            if (i == usedEnd || isReserved(i)) {
+                if (runStart < i) {
+                    _free.setRange(runStart, i - runStart);
+                    _usage.freeFrames += i - runStart;
+                    _usage.usedFrames -= i - runStart;
+                    freeRun(runStart, i - runStart);
+                }
+                runStart = i + 1;
             }
-            _lastAllocFrame = index_to_frame(i + numberOfFrames - 1);
-            return result;
         }
-        else {
-            return sys::Nothing;
+    });
+}
+
+std::size_t PageFrameAllocator::allocBatch(PageFrame *frames, std::size_t count, Zone zone)
+{
+    std::size_t taken = 0;
+    while (taken < count) {
+        auto *state = findZone(zone, 0, true);
+        if (!state) { break; }
+
+        // take the largest block that neither overshoots (the request, or a
+        // fallback zone's watermark) nor needs a split we can avoid
+        auto wanted = std::uint32_t(count - taken);
+        if (state != &zoneState(zone)) {
+            wanted = std::min(wanted, std::uint32_t(state->freeFrames - state->watermark));
+        }
+        auto const order = std::min(floor_order(wanted), floor_order(state->nonEmptyOrders));
+        auto const first = takeFrames(*state, order, block_size(order));
+        for (std::uint32_t i = 0; i < block_size(order); ++i) {
+            frames[taken++] = index_to_frame(first + i);
         }
-    };
-    // start checking from the last place we allocated since the next page is likely available
-    for (uint32_t i = startIndex; i < kPagesInBitmap; ++i) {
-        auto result = findFrames(i);
-        if (result) {
-            return *result;
+    }
+
+    return taken;
+}
+
+void PageFrameAllocator::freeBatch(PageFrame const *frames, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i) {
+        free(frames[i]);
+    }
+}
+
+void PageFrameAllocator::addReference(PageFrame frame)
+{
+    auto &desc = _frames[frame_to_index(frame)];
+    if (desc.shares == std::numeric_limits<std::uint16_t>::max()) {
+        kernel->panic("PageFrameAllocator: too many mappings of a shared frame.");
+    }
+
+    ++desc.shares;
+}
+
+bool PageFrameAllocator::releaseReference(PageFrame frame)
+{
+    auto &desc = _frames[frame_to_index(frame)];
+    if (desc.shares == 0) {
+        return true;
+    }
+
+    --desc.shares;
+    return false;
+}
+
+bool PageFrameAllocator::isShared(PageFrame frame) const
+{
+    return _frames[frame_to_index(frame)].shares != 0;
+}
+
+//===========================================================
+// Buddy system internals
+//===========================================================
+
+PageFrameAllocator::ZoneState &PageFrameAllocator::zoneForIndex(std::uint32_t index)
+{
+    return zoneState(zone_for_index(index));
+}
+
+PageFrameAllocator::ZoneState *PageFrameAllocator::findZone(Zone zone, std::uint32_t order, bool honourWatermarks)
+{
+    if (order > kMaxOrder) { return nullptr; }
+
+    for (auto z = std::size_t(zone) + 1; z-- > 0;) {
+        auto &state = _zones[z];
+        bool const reserved = honourWatermarks && z != std::size_t(zone)
+                              && state.freeFrames < state.watermark + block_size(order);
+        if (!reserved && (state.nonEmptyOrders >> order) != 0) {
+            return &state;
         }
     }
 
-    // we didn't find anything yet, so check the rest
-    for (uint32_t i = 0; i < startIndex; ++i) {
-        auto result = findFrames(i);
-        if (result) {
-            return *result;
+    return nullptr;
+}
+
+std::uint32_t PageFrameAllocator::takeFrames(ZoneState &zone, std::uint32_t order, std::uint32_t count)
+{
+    // take the smallest block that fits and split it down to size, returning
+    // the upper halves to their free lists as we go
+    auto blockOrder = order + std::uint32_t(__builtin_ctz(zone.nonEmptyOrders >> order));
+    auto const index = popFree(zone, blockOrder);
+    while (blockOrder > order) {
+        --blockOrder;
+        pushFree(index + block_size(blockOrder), blockOrder);
+    }
+
+    // give back whatever is left over past a non-power-of-two request
+    _free.clearRange(index, count);
+    _usage.freeFrames -= count;
+    _usage.usedFrames += count;
+    if (count < block_size(order)) {
+        freeRun(index + count, block_size(order) - count);
+    }
+
+    return index;
+}
+
+bool PageFrameAllocator::isFreeHead(std::uint32_t index, std::uint32_t order) const
+{
+    return index < _frameCount
+           && (_frames[index].flags & FrameDescriptor::kFreeHead)
+           && _frames[index].order == order;
+}
+
+void PageFrameAllocator::pushFree(std::uint32_t index, std::uint32_t order)
+{
+    auto &zone = zoneForIndex(index);
+    auto &desc = _frames[index];
+    auto const head = (zone.nonEmptyOrders & block_size(order)) ? zone.freeHeads[order] : FrameDescriptor::kNone;
+    desc.next = head;
+    desc.prev = FrameDescriptor::kNone;
+    desc.order = std::uint8_t(order);
+    desc.flags |= FrameDescriptor::kFreeHead;
+    if (head != FrameDescriptor::kNone) { _frames[head].prev = index; }
+
+    zone.freeHeads[order] = index;
+    zone.nonEmptyOrders |= block_size(order);
+    zone.freeFrames += block_size(order);
+}
+
+void PageFrameAllocator::unlinkFree(std::uint32_t index, std::uint32_t order)
+{
+    auto &zone = zoneForIndex(index);
+    auto &desc = _frames[index];
+    if (desc.prev != FrameDescriptor::kNone) {
+        _frames[desc.prev].next = desc.next;
+    } else {
+        zone.freeHeads[order] = desc.next;
+    }
+
+    if (desc.next != FrameDescriptor::kNone) { _frames[desc.next].prev = desc.prev; }
+    if (zone.freeHeads[order] == FrameDescriptor::kNone) { zone.nonEmptyOrders &= ~block_size(order); }
+    zone.freeFrames -= block_size(order);
+
+    desc.flags &= std::uint8_t(~FrameDescriptor::kFreeHead);
+}
+
+std::uint32_t PageFrameAllocator::popFree(ZoneState &zone, std::uint32_t order)
+{
+    auto const index = zone.freeHeads[order];
+    unlinkFree(index, order);
+    return index;
+}
+
+void PageFrameAllocator::freeBlock(std::uint32_t index, std::uint32_t order)
+{
+    while (order < kMaxOrder) {
+        auto const buddy = index ^ block_size(order);
+        if (!isFreeHead(buddy, order) || zone_for_index(buddy) != zone_for_index(index)) {
+            break;
         }
+
+        unlinkFree(buddy, order);
+        index = std::min(index, buddy);
+        ++order;
     }
 
-    // out of memory
-    kernel->panic("Unable to allocate page frame. Out of memory.");
+    pushFree(index, order);
+}
 
-    return 0;
+void PageFrameAllocator::freeRun(std::uint32_t index, std::uint32_t count)
+{
+    // split the run into the largest naturally aligned blocks it contains
+    while (count > 0) {
+        auto const inZone = std::min(count, zone_end(zone_for_index(index)) - index);
+        auto const order = std::min(alignment_order(index), floor_order(inZone));
+        freeBlock(index, order);
+        index += block_size(order);
+        count -= block_size(order);
+    }
 }
 
-void PageFrameAllocator::free(PageFrame frame, std::size_t numberOfFrames)
+bool PageFrameAllocator::carveFrame(std::uint32_t index)
 {
-    auto const index = frame_to_index(frame);
-    for (auto i = 0_sz; i < numberOfFrames; ++i) {
-        _bitmap.used[index + i] = false;
+    // find the free block containing this frame
+    std::uint32_t order = 0;
+    std::uint32_t head = index;
+    for (; order <= kMaxOrder; ++order) {
+        head = index & ~(block_size(order) - 1);
+        if (isFreeHead(head, order)) {
+            break;
+        }
+    }
+
+    if (order > kMaxOrder) {
+        return false;
     }
+
+    // split it in halves, keeping whichever half doesn't contain the frame
+    unlinkFree(head, order);
+    while (order > 0) {
+        --order;
+        auto const half = block_size(order);
+        if (index >= head + half) {
+            pushFree(head, order);
+            head += half;
+        } else {
+            pushFree(head + half, order);
+        }
+    }
+
+    return true;
 }
@@ -13,13 +13,14 @@
 // PageTable
 //======================================================
 
-void PageTable::invalidatePage(uintptr_t m) { invlpg(m); }
 void PageTable::clear() { std::memset(_tableAddress, 0, X86::kPageTableSize); }
 
 void PageTable::install()
 {
+    // Turn on paging (CR0.PG) and make read-only pages read-only for the
+    // kernel as well (CR0.WP), which copy-on-write depends on.
     asm volatile ("movl %0, %%cr3\n"
                   "mov %%cr0, %0\n"
-                  "orl $0x80000000, %0\n"
+                  "orl $0x80010000, %0\n"
                   "mov %0, %%cr0\n" :: "r"(_tableAddress));
 }
@@ -0,0 +1,28 @@
+#include <arch/i386/mem/TlbBatch.hpp>
+
+#include <system/asm.h>
+
+namespace {
+constexpr std::uint32_t const kCR4GlobalPages = 1u << 7;
+}
+
+void TlbBatch::commit()
+{
+    if (_fullFlush && _global && (read_cr4() & kCR4GlobalPages)) {
+        // toggling PGE drops every translation, global or not
+        auto const cr4 = read_cr4();
+        write_cr4(cr4 & ~kCR4GlobalPages);
+        write_cr4(cr4);
+    } else if (_fullFlush) {
+        asm volatile("movl %%cr3, %%eax\n"
+                     "movl %%eax, %%cr3" ::: "eax", "memory");
+    } else {
+        for (std::size_t i = 0; i < _count; ++i) {
+            invlpg(_pages[i]);
+        }
+    }
+
+    _count = 0;
+    _fullFlush = false;
+    _global = false;
+}
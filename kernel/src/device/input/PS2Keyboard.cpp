@@ -1,6 +1,10 @@
 #include <device/input/PS2Keyboard.hpp>
 
-#include <system/asm.h>
+#include <arch/i386/X86Kernel.hpp>
+#include <cpu/InterruptGuard.hpp>
+#include <proc/Process.hpp>
+#include <Kernel.hpp>
+
 #include <string.h>
 
 PS2Keyboard::PS2Keyboard() : _buffer(128)
@@ -26,13 +30,43 @@ static constexpr KeyCode const * currentScanCodeSet = kScanSet1;
 void PS2Keyboard::pushScanCode(uint8_t scancode)
 {
     _buffer.enqueue(scancode);
+    if (_reader) {
+        kernel->scheduler().setState(*_reader, Process::State::Runnable);
+        _reader = nullptr;
+    }
+}
+
+void PS2Keyboard::waitForScanCode()
+{
+    auto &processes = kernel->scheduler();
+    auto *curr = processes.currentProcess();
+    if (!curr || !curr->procState) {
+        kernel->idle();
+        return;
+    }
+
+    _reader = curr;
+    processes.setState(*curr, Process::State::Sleeping);
+    while (_reader) {
+        if (processes.hasRunnableProcess()) {
+            x86Kernel->schedule();
+        } else {
+            kernel->idle();
+        }
+    }
+    processes.setCurrentProcess(curr);
 }
 
 KeyEvent PS2Keyboard::read()
 {
     KeyEvent retval;
-    while (_buffer.isEmpty()) { halt(); }
-    auto scancode = uint32_t(_buffer.pop());
+    uint32_t scancode;
+    {
+        // with interrupts off, a key can only arrive while waiting, so a wakeup can't be missed
+        InterruptGuard guard;
+        while (_buffer.isEmpty()) { waitForScanCode(); }
+        scancode = uint32_t(_buffer.pop());
+    }
     if ((scancode & 128) == 128) {
         retval.type = kKeyEventReleased;
     } else {
@@ -3,6 +3,7 @@
 #include <util/StaticList.hpp>
 #include <util/LinkedList.hpp>
 #include <system/asm.h>
+#include <Kernel.hpp>
 #include <cstring>
 #include <util/StringTokenizer.hpp>
 
@@ -80,8 +81,17 @@ rockridge::AltNameEntryInfo *findRockRidgeNameEntry(char *ptr, std::ptrdiff_t le
 class IsoFileStream : public sys::InputStream
 {
   public:
+    // big files go straight into 4 MiB pages instead of through the heap, if we can get them
     IsoFileStream(size_t fileSize, size_t bufferSize)
-            : _fileSize(fileSize), _buffer(bufferSize) {}
+            : _fileSize(fileSize)
+            , _largePages(bufferSize >= MMU::kLargePageSize ? sys::div_ceil(bufferSize, MMU::kLargePageSize) : 0)
+            , _largeBuffer(_largePages ? static_cast<std::byte *>(kernel->pallocLarge(_largePages)) : nullptr)
+            , _buffer(_largeBuffer ? 0 : bufferSize) {}
+
+    ~IsoFileStream() override
+    {
+        if (_largeBuffer) { kernel->pfreeLarge(_largeBuffer, _largePages); }
+    }
 
     size_t available() const override { return _fileSize - _pos; }
 
@@ -95,7 +105,7 @@ class IsoFileStream : public sys::InputStream
             --_readsUntilInvalid;
         }
 
-        return _buffer[_pos++];
+        return buffer()[_pos++];
     }
 
     void mark(size_t readsLeft) override
@@ -113,10 +123,12 @@ class IsoFileStream : public sys::InputStream
         }
     }
 
-    std::byte *buffer() { return _buffer.get(); }
+    std::byte *buffer() { return _largeBuffer ? _largeBuffer : _buffer.get(); }
 
   private:
     size_t _fileSize = 0;
+    size_t _largePages = 0;
+    std::byte *_largeBuffer = nullptr;
     sys::StaticList<std::byte> _buffer;
     size_t _pos = 0;
     size_t _mark = 0;
@@ -0,0 +1,26 @@
+#include <mem/FrameCache.hpp>
+
+#include <cstring>
+
+void FrameCache::flush()
+{
+    _backing->freeBatch(_frames, _count);
+    _count = 0;
+}
+
+void FrameCache::refill()
+{
+    _count = _backing->allocBatch(_frames, kBatch, _zone);
+    if (_count == 0) {
+        // out of memory: let the allocator report it
+        _frames[_count++] = _backing->alloc(1, _zone);
+    }
+}
+
+void FrameCache::drain()
+{
+    // the oldest frames are at the bottom; return those and keep the hot ones
+    _backing->freeBatch(_frames, kBatch);
+    std::memmove(_frames, _frames + kBatch, (_count - kBatch) * sizeof(PageFrame));
+    _count -= kBatch;
+}
@@ -4,9 +4,36 @@
 
 #include <mem/Heap.hpp>
 
-std::uintptr_t Heap::grow(std::uintptr_t size) noexcept
+#include <Kernel.hpp>
+
+std::uintptr_t Heap::grow(std::ptrdiff_t increment) noexcept
 {
-    auto oldEnd = _end;
-    _end += size;
+    auto const oldEnd = _end;
+    auto const magnitude = increment < 0 ? -static_cast<std::uintptr_t>(increment) : std::uintptr_t(increment);
+    if (increment < 0 ? magnitude > _end - _begin : magnitude > _limit - _end) {
+        return UINTPTR_MAX;
+    }
+
+    auto const newEnd = increment < 0 ? _end - magnitude : _end + magnitude;
+    auto const newAlignedEnd = pageAlign(newEnd);
+    if (newAlignedEnd > _limit) {
+        return UINTPTR_MAX;
+    }
+
+    if (newAlignedEnd > _alignedEnd) {
+        VirtualMemoryMap::Area area{.start = _alignedEnd,
+                                    .end = newAlignedEnd,
+                                    .protection = VirtualMemoryMap::kProtRead | VirtualMemoryMap::kProtWrite};
+        if (!kernel->pallocLazy(area)) {
+            return UINTPTR_MAX;
+        }
+    } else if (newAlignedEnd < _alignedEnd) {
+        if (kernel->pfree(reinterpret_cast<void *>(newAlignedEnd), (_alignedEnd - newAlignedEnd) / 0x1000) != 0) {
+            return UINTPTR_MAX;
+        }
+    }
+
+    _end = newEnd;
+    _alignedEnd = newAlignedEnd;
     return oldEnd;
 }
@@ -0,0 +1,129 @@
+#include <mem/HeapProfiler.hpp>
+
+#include <cpu/InterruptGuard.hpp>
+#include <io/Print.hpp>
+
+namespace {
+
+constinit HeapProfiler g_heapProfiler{};
+
+constexpr std::size_t const kSmallestBucket = 16;
+
+}
+
+HeapProfiler &HeapProfiler::instance() { return g_heapProfiler; }
+
+void HeapProfiler::recordAllocation(void const *block, std::size_t size, void const *caller)
+{
+    InterruptGuard guard;
+    if (!block) {
+        ++_failures;
+        return;
+    }
+
+    ++_allocations;
+    ++_histogram[bucketFor(size)];
+
+    // a block which can't be tracked would never be seen freed, so it isn't counted as live either
+    auto *site = siteFor(caller);
+    if (!site || _liveBlockCount == kMaxLiveBlocks) {
+        ++_untracked;
+        return;
+    }
+
+    _liveBytes += size;
+    if (_liveBytes > _peakBytes) { _peakBytes = _liveBytes; }
+
+    ++site->allocations;
+    site->totalBytes += size;
+    site->liveBytes += size;
+    if (site->liveBytes > site->peakBytes) { site->peakBytes = site->liveBytes; }
+
+    auto index = hash(block, kMaxLiveBlocks);
+    while (_liveBlocks[index].block) { index = (index + 1) % kMaxLiveBlocks; }
+    _liveBlocks[index] = {block, size, static_cast<std::uint16_t>(site - _sites)};
+    ++_liveBlockCount;
+}
+
+void HeapProfiler::recordFree(void const *block)
+{
+    InterruptGuard guard;
+    auto index = hash(block, kMaxLiveBlocks);
+    for (std::size_t probes = 0; _liveBlocks[index].block != block; ++probes) {
+        if (!_liveBlocks[index].block || probes == kMaxLiveBlocks) {
+            return; // allocated while the tables were full
+        }
+        index = (index + 1) % kMaxLiveBlocks;
+    }
+
+    auto const live = _liveBlocks[index];
+    ++_frees;
+    _liveBytes -= live.size;
+    ++_sites[live.site].frees;
+    _sites[live.site].liveBytes -= live.size;
+
+    // backward shift deletion: pull later entries of the probe run into the hole
+    auto hole = index;
+    for (auto next = (hole + 1) % kMaxLiveBlocks; _liveBlocks[next].block; next = (next + 1) % kMaxLiveBlocks) {
+        auto const home = hash(_liveBlocks[next].block, kMaxLiveBlocks);
+        if ((next - home) % kMaxLiveBlocks >= (next - hole) % kMaxLiveBlocks) {
+            _liveBlocks[hole] = _liveBlocks[next];
+            hole = next;
+        }
+    }
+    _liveBlocks[hole] = {};
+    --_liveBlockCount;
+}
+
+void HeapProfiler::dump(sys::OutputStream &out) const
+{
+    InterruptGuard guard;
+    sys::println(out, "HEAPPROF TOTAL allocs=%@ frees=%@ failed=%@ untracked=%@ live=%@ peak=%@", _allocations, _frees,
+                 _failures, _untracked, _liveBytes, _peakBytes);
+
+    for (std::size_t i = 0; i < kHistogramBuckets; ++i) {
+        if (_histogram[i]) {
+            sys::println(out, "HEAPPROF HIST le=%@ count=%@", kSmallestBucket << i, _histogram[i]);
+        }
+    }
+
+    for (auto const &site : _sites) {
+        if (site.allocations) {
+            sys::println(out, "HEAPPROF SITE caller=%x allocs=%@ frees=%@ live=%@ peak=%@ total=%@", site.caller,
+                         site.allocations, site.frees, site.liveBytes, site.peakBytes, site.totalBytes);
+        }
+    }
+}
+
+std::size_t HeapProfiler::hash(void const *pointer, std::size_t capacity)
+{
+    // blocks are at least 16 byte aligned, so the low bits carry nothing
+    auto const value = static_cast<std::uint32_t>(reinterpret_cast<std::uintptr_t>(pointer) >> 4u);
+    return (value * 2654435761u) % capacity;
+}
+
+std::size_t HeapProfiler::bucketFor(std::size_t size)
+{
+    std::size_t bucket = 0;
+    for (auto limit = kSmallestBucket; size > limit && bucket < kHistogramBuckets - 1; limit *= 2) {
+        ++bucket;
+    }
+
+    return bucket;
+}
+
+HeapProfiler::Site *HeapProfiler::siteFor(void const *caller)
+{
+    auto index = hash(caller, kMaxSites);
+    for (std::size_t probes = 0; probes < kMaxSites; ++probes) {
+        auto &site = _sites[index];
+        if (site.caller == caller) { return &site; }
+        if (!site.allocations) {
+            site.caller = caller;
+            return &site;
+        }
+        index = (index + 1) % kMaxSites;
+    }
+
+    return nullptr;
+}
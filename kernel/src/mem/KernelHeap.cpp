@@ -0,0 +1,205 @@
+#include <mem/KernelHeap.hpp>
+
+#include <Kernel.hpp>
+#include <cpu/InterruptGuard.hpp>
+#include <io/Print.hpp>
+#include <mem/HeapProfiler.hpp>
+#include <system/Debug.hpp>
+
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t const kGranule = 16;
+
+/** The size class for each multiple of kGranule up to the largest class, built at compile time. */
+constexpr auto kClassForGranule = [] {
+    constexpr std::size_t kClassSizes[] = {16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024};
+    constexpr std::size_t kGranules = kClassSizes[sizeof(kClassSizes) / sizeof(*kClassSizes) - 1] / kGranule;
+
+    struct
+    {
+        std::uint8_t index[kGranules + 1];
+    } table{};
+    std::size_t sizeClass = 0;
+    for (std::size_t granule = 0; granule <= kGranules; ++granule) {
+        while (kClassSizes[sizeClass] < granule * kGranule) { ++sizeClass; }
+        table.index[granule] = static_cast<std::uint8_t>(sizeClass);
+    }
+    return table;
+}();
+
+constinit KernelHeap g_kernelHeap{};
+
+} // namespace
+
+KernelHeap &KernelHeap::instance() { return g_kernelHeap; }
+
+void *KernelHeap::allocate(std::size_t size)
+{
+    if (size == 0) { size = 1; }
+    return size <= kMaxSmallSize ? _caches[sizeClass(size)].alloc() : allocateLarge(size);
+}
+
+void *KernelHeap::allocateAligned(std::size_t alignment, std::size_t size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > kPageSize) { return nullptr; }
+    if (alignment <= kAlignment) { return allocate(size); }
+
+    // the class holding a multiple of the alignment is aligned at least as much, see the class comment
+    if (size <= kMaxSmallSize) {
+        auto const rounded = (size + alignment - 1) & ~(alignment - 1);
+        if (rounded <= kMaxSmallSize) { return _caches[sizeClass(rounded == 0 ? alignment : rounded)].alloc(); }
+    }
+
+    return allocateLarge(size, alignment);
+}
+
+void *KernelHeap::reallocate(void *block, std::size_t size)
+{
+    if (!block) { return allocate(size); }
+    if (size == 0) {
+        free(block);
+        return nullptr;
+    }
+
+    auto const oldSize = usableSize(block);
+    if (size <= oldSize) { return block; }
+
+    void *moved = allocate(size);
+    if (moved) {
+        std::memcpy(moved, block, oldSize);
+        free(block);
+    }
+    return moved;
+}
+
+void *KernelHeap::allocateZeroed(std::size_t count, std::size_t size)
+{
+    if (size != 0 && count > SIZE_MAX / size) { return nullptr; }
+
+    void *block = allocate(count * size);
+    if (block) { std::memset(block, 0, count * size); }
+    return block;
+}
+
+void KernelHeap::free(void *block)
+{
+    if (!block) { return; }
+
+    if (auto *cache = isPageAligned(block) ? nullptr : SlabCache::cacheOf(block)) {
+        cache->free(block);
+    } else {
+        freeLarge(headerOf(block));
+    }
+}
+
+void KernelHeap::shrink()
+{
+    for (auto &cache : _caches) { cache.shrink(); }
+}
+
+void KernelHeap::report(sys::OutputStream &out) const
+{
+    for (auto const &cache : _caches) { cache.report(out); }
+    sys::println(out, "HEAPPROF LARGE blocks=%@ pages=%@", _largeBlocks, _largePages);
+}
+
+std::size_t KernelHeap::sizeClass(std::size_t size)
+{
+    return kClassForGranule.index[(size + kGranule - 1) / kGranule];
+}
+
+std::size_t KernelHeap::usableSize(void *block)
+{
+    if (!isPageAligned(block)) {
+        if (auto *cache = SlabCache::cacheOf(block)) { return cache->objectSize(); }
+    }
+
+    auto *header = headerOf(block);
+    auto const offset = reinterpret_cast<std::uintptr_t>(block) - reinterpret_cast<std::uintptr_t>(header);
+    return header->pages * kPageSize - offset;
+}
+
+KernelHeap::LargeHeader *KernelHeap::headerOf(void *block)
+{
+    auto const address = reinterpret_cast<std::uintptr_t>(block);
+    auto const page = address & ~(kPageSize - 1);
+    return reinterpret_cast<LargeHeader *>(page == address ? page - kPageSize : page);
+}
+
+void *KernelHeap::allocateLarge(std::size_t size, std::size_t alignment)
+{
+    // the block starts at the first suitably aligned spot past the header
+    auto const offset = alignment < sizeof(LargeHeader) ? sizeof(LargeHeader) : alignment;
+    if (size > SIZE_MAX - offset - kPageSize) { return nullptr; }
+
+    auto const pages = (size + offset + kPageSize - 1) / kPageSize;
+    InterruptGuard guard;
+    auto *header = static_cast<LargeHeader *>(kernel->palloc(pages));
+    if (!header) { return nullptr; }
+
+    header->cache = nullptr;
+    header->pages = pages;
+    ++_largeBlocks;
+    _largePages += pages;
+    return reinterpret_cast<std::byte *>(header) + offset;
+}
+
+void KernelHeap::freeLarge(LargeHeader *header)
+{
+    // not unmap(): neighbouring blocks share a memory area, so only our own pages may go
+    InterruptGuard guard;
+    if (kernel->pfree(header, header->pages) != 0) {
+        // too fragmented to record the hole; the block stays mapped rather than half freed
+        sys::debug_println("KernelHeap: unable to free a %@ page block", header->pages);
+        return;
+    }
+
+    --_largeBlocks;
+    _largePages -= header->pages;
+}
+
+__BEGIN_DECLS
+
+// The _from variants take the caller to charge in the heap profile, for wrappers such as operator new.
+
+void *kmalloc_from(size_t size, void const *caller)
+{
+    void *block = g_kernelHeap.allocate(size);
+    profileAllocation(block, size, caller);
+    return block;
+}
+
+void *kmemalign_from(size_t alignment, size_t size, void const *caller)
+{
+    void *block = g_kernelHeap.allocateAligned(alignment, size);
+    profileAllocation(block, size, caller);
+    return block;
+}
+
+void *kmalloc(size_t size) { return kmalloc_from(size, __builtin_return_address(0)); }
+void *kmemalign(size_t alignment, size_t size) { return kmemalign_from(alignment, size, __builtin_return_address(0)); }
+
+void *krealloc(void *ptr, size_t size)
+{
+    void *block = g_kernelHeap.reallocate(ptr, size);
+    if (block || size == 0) { profileFree(ptr); }
+    if (block || size != 0) { profileAllocation(block, size, __builtin_return_address(0)); }
+    return block;
+}
+
+void *kcalloc(size_t num, size_t size)
+{
+    void *block = g_kernelHeap.allocateZeroed(num, size);
+    profileAllocation(block, num * size, __builtin_return_address(0));
+    return block;
+}
+
+void kfree(void *ptr)
+{
+    profileFree(ptr);
+    g_kernelHeap.free(ptr);
+}
+
+__END_DECLS
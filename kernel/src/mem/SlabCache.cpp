@@ -0,0 +1,160 @@
+#include <mem/SlabCache.hpp>
+
+#include <Kernel.hpp>
+#include <cpu/InterruptGuard.hpp>
+#include <io/Print.hpp>
+
+void *SlabCache::alloc()
+{
+    InterruptGuard guard;
+    Slab *slab = _partial.head;
+    if (!slab) {
+        if ((slab = _empty.head)) {
+            _empty.remove(slab);
+            --_emptySlabs;
+        } else if (!(slab = grow())) {
+            return nullptr;
+        }
+        _partial.push(slab);
+    }
+
+    void *object = slab->freeList;
+    slab->freeList = linkOf(object);
+    if (++slab->inUse == _objectsPerSlab) {
+        _partial.remove(slab);
+        _full.push(slab);
+    }
+
+    ++_objectsInUse;
+    return object;
+}
+
+void SlabCache::free(void *object)
+{
+    if (!object) { return; }
+
+    InterruptGuard guard;
+    Slab *slab = slabOf(object);
+    linkOf(object) = slab->freeList;
+    slab->freeList = object;
+    --_objectsInUse;
+
+    if (slab->inUse-- == _objectsPerSlab) {
+        _full.remove(slab);
+        _partial.push(slab);
+    }
+
+    if (slab->inUse == 0) {
+        _partial.remove(slab);
+        // a slab the MMU can't take back right now is kept like any other
+        if (_emptySlabs < kMaxEmptySlabs || kernel->pfree(slab) != 0) {
+            _empty.push(slab);
+            ++_emptySlabs;
+        } else {
+            --_slabCount;
+        }
+    }
+}
+
+void SlabCache::shrink()
+{
+    InterruptGuard guard;
+    while (Slab *slab = _empty.head) {
+        if (kernel->pfree(slab) != 0) {
+            break;
+        }
+        _empty.remove(slab);
+        --_emptySlabs;
+        --_slabCount;
+    }
+}
+
+void SlabCache::report(sys::OutputStream &out) const
+{
+    sys::println(out, "HEAPPROF CLASS name=%@ size=%@ inuse=%@ capacity=%@ pages=%@", _name, _objectSize, _objectsInUse,
+                 _slabCount * _objectsPerSlab, _slabCount * (kSlabSize / 0x1000));
+}
+
+SlabCache::Slab *SlabCache::grow()
+{
+    auto *slab = static_cast<Slab *>(kernel->palloc(kSlabSize / 0x1000));
+    if (!slab) {
+        return nullptr;
+    }
+
+    ++_slabCount;
+    slab->cache = this;
+    slab->prev = slab->next = nullptr;
+    slab->inUse = 0;
+
+    // thread the free list front to back, so that objects are handed out in address order
+    slab->freeList = nullptr;
+    auto *objects = reinterpret_cast<std::byte *>(slab) + _firstObject;
+    for (std::size_t i = _objectsPerSlab; i-- > 0;) {
+        void *object = objects + i * _stride;
+        if (_constructor) { _constructor(object); }
+        linkOf(object) = slab->freeList;
+        slab->freeList = object;
+    }
+
+    return slab;
+}
+
+void SlabCache::SlabList::push(Slab *slab)
+{
+    slab->prev = nullptr;
+    slab->next = head;
+    if (head) { head->prev = slab; }
+    head = slab;
+}
+
+void SlabCache::SlabList::remove(Slab *slab)
+{
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        head = slab->next;
+    }
+
+    if (slab->next) { slab->next->prev = slab->prev; }
+    slab->prev = slab->next = nullptr;
+}
+
+//===========================================================
+// SlabObjectAllocator
+//===========================================================
+
+void *SlabObjectAllocator::allocate(std::size_t size) noexcept
+{
+    auto const index = sizeClass(size);
+    if (index == kSizeClasses) { return ::operator new(size, std::nothrow); }
+
+    void *object = _caches[index].alloc();
+    profileAllocation(object, size, __builtin_return_address(0));
+    return object;
+}
+
+void SlabObjectAllocator::deallocate(void *object, std::size_t size) noexcept
+{
+    if (auto const index = sizeClass(size); index < kSizeClasses) {
+        profileFree(object);
+        _caches[index].free(object);
+    } else {
+        ::operator delete(object);
+    }
+}
+
+void SlabObjectAllocator::report(sys::OutputStream &out) const
+{
+    for (auto const &cache : _caches) { cache.report(out); }
+}
+
+std::size_t SlabObjectAllocator::sizeClass(std::size_t size)
+{
+    std::size_t index = 0;
+    for (auto classSize = kSmallestClass; classSize < size && index < kSizeClasses; classSize *= 2) {
+        ++index;
+    }
+
+    return index;
+}
@@ -0,0 +1,161 @@
+#include <mem/VirtualMemoryMap.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t const kPageSize = 0x1000;
+
+}
+
+std::byte const *VirtualMemoryMap::Area::dataFor(std::uintptr_t page, std::size_t *size) const
+{
+    auto const offset = page - start;
+    if (!data || offset >= dataSize) {
+        *size = 0;
+        return nullptr;
+    }
+
+    *size = std::min<std::size_t>(kPageSize, dataSize - offset);
+    return data + offset;
+}
+
+VirtualMemoryMap::Area const *VirtualMemoryMap::find(std::uintptr_t address) const
+{
+    // the only area which could hold the address is the last one starting at or below it
+    auto const index = upperBound(address);
+    if (index == 0 || !_areas[index - 1].contains(address)) {
+        return nullptr;
+    }
+
+    return &_areas[index - 1];
+}
+
+bool VirtualMemoryMap::covers(std::uintptr_t start, std::uintptr_t end, std::uint8_t flags) const
+{
+    if (start >= end) { return true; }
+
+    // walk the areas from the one holding start, as long as each picks up where the last one ended
+    auto index = upperBound(start);
+    if (index == 0 || !_areas[index - 1].contains(start) || (_areas[index - 1].flags & flags) != flags) {
+        return false;
+    }
+
+    auto covered = _areas[index - 1].end;
+    for (; covered < end && index < _count && _areas[index].start == covered; ++index) {
+        if ((_areas[index].flags & flags) != flags) { return false; }
+        covered = _areas[index].end;
+    }
+
+    return covered >= end;
+}
+
+bool VirtualMemoryMap::insert(Area const &area)
+{
+    if (area.start >= area.end) {
+        return false;
+    }
+
+    auto const index = upperBound(area.start);
+    if ((index > 0 && _areas[index - 1].end > area.start) || (index < _count && _areas[index].start < area.end)) {
+        return false;
+    }
+
+    // grow a neighbour where possible, so that back to back allocations don't each take a slot
+    bool const mergesBefore = index > 0 && _areas[index - 1].end == area.start && mergeable(_areas[index - 1], area);
+    bool const mergesAfter = index < _count && area.end == _areas[index].start && mergeable(area, _areas[index]);
+    if (mergesBefore && mergesAfter) {
+        _areas[index - 1].end = _areas[index].end;
+        erase(index, index + 1);
+    } else if (mergesBefore) {
+        _areas[index - 1].end = area.end;
+    } else if (mergesAfter) {
+        _areas[index].start = area.start;
+    } else if (_count < kMaxAreas) {
+        insertAt(index, area);
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool VirtualMemoryMap::remove(std::uintptr_t start, std::uintptr_t end)
+{
+    if (start >= end) { return true; }
+
+    // [first, last) are the areas overlapping the range
+    auto first = upperBound(start);
+    if (first > 0 && _areas[first - 1].end > start) { --first; }
+    auto last = upperBound(end - 1);
+    if (first == last) { return true; }
+
+    // a hole in the middle of a single area splits it in two
+    auto &head = _areas[first];
+    if (last - first == 1 && head.start < start && head.end > end) {
+        if (_count == kMaxAreas) { return false; }
+
+        Area tail = head;
+        trimFront(tail, end);
+        head.end = start;
+        insertAt(first + 1, tail);
+        return true;
+    }
+
+    // otherwise the areas on either end may survive in part, and the rest go
+    if (head.start < start) {
+        head.end = start;
+        ++first;
+    }
+
+    if (auto &tail = _areas[last - 1]; first < last && tail.end > end) {
+        trimFront(tail, end);
+        --last;
+    }
+
+    if (first < last) { erase(first, last); }
+    return true;
+}
+
+std::size_t VirtualMemoryMap::upperBound(std::uintptr_t address) const
+{
+    std::size_t low = 0, high = _count;
+    while (low < high) {
+        auto const mid = (low + high) / 2;
+        if (_areas[mid].start <= address) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+bool VirtualMemoryMap::mergeable(Area const &lower, Area const &upper)
+{
+    return lower.backing == Backing::kAnonymous && upper.backing == Backing::kAnonymous && !lower.data
+           && !upper.data && lower.protection == upper.protection && lower.flags == upper.flags;
+}
+
+void VirtualMemoryMap::trimFront(Area &area, std::uintptr_t newStart)
+{
+    auto const consumed = std::min<std::size_t>(newStart - area.start, area.dataSize);
+    if (area.data) { area.data += consumed; }
+    area.dataSize -= consumed;
+    area.start = newStart;
+}
+
+void VirtualMemoryMap::insertAt(std::size_t index, Area const &area)
+{
+    std::memmove(_areas + index + 1, _areas + index, (_count - index) * sizeof(Area));
+    _areas[index] = area;
+    ++_count;
+}
+
+void VirtualMemoryMap::erase(std::size_t first, std::size_t last)
+{
+    std::memmove(_areas + first, _areas + last, (_count - last) * sizeof(Area));
+    _count -= last - first;
+}
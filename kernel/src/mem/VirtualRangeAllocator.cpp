@@ -0,0 +1,126 @@
+#include <mem/VirtualRangeAllocator.hpp>
+
+#include <cstring>
+
+std::uintptr_t VirtualRangeAllocator::allocate(std::size_t pages, std::size_t alignment)
+{
+    if (pages == 0) { return 0; }
+
+    for (std::size_t i = 0; i < _count; ++i) {
+        auto &extent = _extents[i];
+        auto const first = (extent.first + std::uint32_t(alignment) - 1) & ~std::uint32_t(alignment - 1);
+        if (first < extent.first || first + pages > extent.end()) {
+            continue;
+        }
+
+        if (first == extent.first) {
+            extent.first += std::uint32_t(pages);
+            extent.count -= std::uint32_t(pages);
+            if (extent.count == 0) { erase(i); }
+
+            _freePages -= pages;
+            return std::uintptr_t(first) * kPageSize;
+        }
+
+        // an aligned range from the middle of the extent may need to split it
+        auto const address = std::uintptr_t(first) * kPageSize;
+        if (reserve(address, pages)) {
+            return address;
+        }
+    }
+
+    return 0;
+}
+
+bool VirtualRangeAllocator::reserve(std::uintptr_t address, std::size_t pages)
+{
+    auto const first = std::uint32_t(address / kPageSize);
+    auto const end = first + std::uint32_t(pages);
+    if (pages == 0) { return true; }
+
+    // the only extent which could contain the range is the last one starting at or below it
+    auto const index = upperBound(first);
+    if (index == 0) { return false; }
+
+    auto const extent = _extents[index - 1];
+    if (end > extent.end()) { return false; }
+
+    // cut the range out, leaving up to one extent on either side of it
+    Extent const before{extent.first, first - extent.first};
+    Extent const after{end, extent.end() - end};
+    if (before.count && after.count) {
+        if (_count == kMaxExtents) { return false; }
+
+        _extents[index - 1] = before;
+        insert(index, after);
+    } else if (before.count) {
+        _extents[index - 1] = before;
+    } else if (after.count) {
+        _extents[index - 1] = after;
+    } else {
+        erase(index - 1);
+    }
+
+    _freePages -= pages;
+    return true;
+}
+
+bool VirtualRangeAllocator::release(std::uintptr_t address, std::size_t pages)
+{
+    if (pages == 0) { return true; }
+
+    Extent extent{std::uint32_t(address / kPageSize), std::uint32_t(pages)};
+    auto index = upperBound(extent.first);
+    if ((index > 0 && _extents[index - 1].end() > extent.first)
+        || (index < _count && _extents[index].first < extent.end())) {
+        return false; // giving back a free page twice would let it be handed out twice
+    }
+
+    // merge with the neighbours it touches
+    bool const mergesBefore = index > 0 && _extents[index - 1].end() == extent.first;
+    bool const mergesAfter = index < _count && extent.end() == _extents[index].first;
+    if (mergesBefore && mergesAfter) {
+        _extents[index - 1].count += extent.count + _extents[index].count;
+        erase(index);
+    } else if (mergesBefore) {
+        _extents[index - 1].count += extent.count;
+    } else if (mergesAfter) {
+        _extents[index].first = extent.first;
+        _extents[index].count += extent.count;
+    } else if (_count < kMaxExtents) {
+        insert(index, extent);
+    } else {
+        return false;
+    }
+
+    _freePages += pages;
+    return true;
+}
+
+std::size_t VirtualRangeAllocator::upperBound(std::uint32_t page) const
+{
+    std::size_t low = 0, high = _count;
+    while (low < high) {
+        auto const mid = (low + high) / 2;
+        if (_extents[mid].first <= page) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+void VirtualRangeAllocator::insert(std::size_t index, Extent extent)
+{
+    std::memmove(_extents + index + 1, _extents + index, (_count - index) * sizeof(Extent));
+    _extents[index] = extent;
+    ++_count;
+}
+
+void VirtualRangeAllocator::erase(std::size_t index)
+{
+    std::memmove(_extents + index, _extents + index + 1, (_count - index - 1) * sizeof(Extent));
+    --_count;
+}
@@ -0,0 +1,44 @@
+#include <proc/ProcessTable.hpp>
+
+#include <utility>
+
+Process *ProcessTable::insert(Process &&process)
+{
+    auto const slot = used_.findFirstClear();
+    if (slot == decltype(used_)::kNotFound) {
+        return nullptr;
+    }
+
+    auto *home = cache_.create(std::move(process));
+    if (!home) {
+        return nullptr;
+    }
+
+    home->pid = Process::ID(generations_[slot] * kMaxProcesses + slot);
+    slots_[slot] = home;
+    used_.set(slot);
+    return home;
+}
+
+Process *ProcessTable::find(Process::ID pid) const
+{
+    if (pid < 0) {
+        return nullptr;
+    }
+
+    auto *process = slots_[slotOf(pid)];
+    return process && process->pid == pid ? process : nullptr;
+}
+
+void ProcessTable::remove(Process &process)
+{
+    auto const slot = slotOf(process.pid);
+    if (slots_[slot] != &process) {
+        return;
+    }
+
+    slots_[slot] = nullptr;
+    used_.unset(slot);
+    generations_[slot] = (generations_[slot] + 1) % kGenerations;
+    cache_.destroy(&process);
+}
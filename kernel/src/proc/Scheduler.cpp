@@ -7,16 +7,34 @@
 #include <system/Debug.hpp>
 
 
-/** Enqueues an embryo process into the dormant process list. */
+/** Makes a process the current one, taking it out of the run queue if it was waiting there. */
+void Scheduler::setCurrentProcess(Process *process)
+{
+   if (process) {
+       setState(*process, Process::State::Running);
+   }
+   activeProcess_ = process;
+}
+
+/** Moves an embryo process into the process table and gives it a pid. */
 Process * Scheduler::enqueueEmbryo(Process&& process)
 {
    process.state = Process::State::Embryo;
    process.procState = nullptr;
-   if (!dormantProcesses_.enqueue(std::move(process))) {
-       return nullptr;
-   }
+   process.runNext = nullptr;
+   process.runPrev = nullptr;
+   process.ticksLeft = 0;
+   return processes_.insert(std::move(process));
+}
 
-   return &dormantProcesses_[dormantProcesses_.size() - 1];
+/** Takes a process out of scheduling and frees it and its pid. */
+void Scheduler::destroyProcess(Process& process)
+{
+   setState(process, Process::State::Unused);
+   if (activeProcess_ == &process) {
+       activeProcess_ = nullptr;
+   }
+   processes_.remove(process);
 }
 
 /**
@@ -27,7 +45,7 @@ bool Scheduler::makeRunnable(Process& process, Process::ICpuState *cpuState)
 {
    if (process.state != Process::State::Embryo ||
        cpuState == nullptr ||
-       !process.addressSpace ||
+       process.pgdir == nullptr ||
        process.kernStack == nullptr)
    {
        return false;
@@ -35,38 +53,105 @@ bool Scheduler::makeRunnable(Process& process, Process::ICpuState *cpuState)
 
    // sys::debug_println("Making process %@ runnable", process.pid);
    process.procState = cpuState;
-   process.state = Process::State::Runnable;
+   setState(process, Process::State::Runnable);
    return true;
 }
 
-Process * Scheduler::nextProcess()
+/**
+ * Changes a process's state, adding it to or removing it from the run queue as
+ * it becomes or stops being runnable.
+ */
+void Scheduler::setState(Process& process, Process::State state)
 {
-   auto nextEligible = std::ranges::find_if(dormantProcesses_, [](Process const &p) {
-       return p.state == Process::State::Runnable;
-   });
-   if (nextEligible != dormantProcesses_.end()) {
-       return std::addressof(*nextEligible);
+   if (process.state == state) {
+       return;
    }
 
+   if (process.state == Process::State::Runnable) {
+       runQueue_.remove(process);
+   }
+   process.state = state;
+   if (state == Process::State::Runnable) {
+       runQueue_.enqueue(process);
+
+       // a more urgent process doesn't wait for the current one's slice to end
+       if (activeProcess_ && RunQueue::levelOf(process) < RunQueue::levelOf(*activeProcess_)) {
+           requestReschedule();
+       }
+   }
+}
+
+Process * Scheduler::nextProcess()
+{
    auto *curr = currentProcess();
-   if (!curr) {
-       return nullptr;
+   bool const currentCanRun = curr && curr->state == Process::State::Running;
+   auto *queued = runQueue_.front();
+   if (!queued) {
+       return currentCanRun ? curr : nullptr;
+   }
+
+   // round robin within a level: the current process goes behind its equals
+   // once its time slice is used up
+   if (currentCanRun) {
+       auto const currentLevel = RunQueue::levelOf(*curr);
+       auto const queuedLevel = RunQueue::levelOf(*queued);
+       if (currentLevel < queuedLevel || (currentLevel == queuedLevel && curr->ticksLeft > 0)) {
+           return curr;
+       }
    }
 
-   return (curr->state == Process::State::Running || curr->state == Process::State::Runnable)
-           ? curr
-           : nullptr;
+   return queued;
 }
 
-/** Selects the next process and marks it as the current process. */
+/**
+ * Selects the next process and marks it as the current process, with a fresh
+ * time slice if it needs one. Clears any reschedule request.
+ */
 Process * Scheduler::promoteNextProcessToCurrent()
 {
-   if (auto next = nextProcess(); next != activeProcess_) {
-       if (activeProcess_) {
-           activeProcess_->state = Process::State::Runnable;
+   needResched_ = false;
+
+   // with nothing able to run, the current process stays current, so that
+   // whatever wakes something up has somewhere to switch from
+   if (auto next = nextProcess(); next && next != activeProcess_) {
+       if (activeProcess_ && activeProcess_->state == Process::State::Running) {
+           setState(*activeProcess_, Process::State::Runnable);
        }
-       activeProcess_ = next;
+       setCurrentProcess(next);
+   }
+
+   if (activeProcess_ && activeProcess_->ticksLeft == 0) {
+       activeProcess_->ticksLeft = quantumFor(*activeProcess_);
    }
 
    return activeProcess_;
 }
+
+/**
+ * Charges a timer tick to the current process, and asks for a reschedule once
+ * its time slice has run out. Called from the timer interrupt.
+ */
+void Scheduler::tick()
+{
+   auto *curr = currentProcess();
+   if (!curr || curr->state != Process::State::Running) {
+       return;
+   }
+
+   if (curr->ticksLeft > 0) {
+       --curr->ticksLeft;
+   }
+
+   if (curr->ticksLeft == 0 && !runQueue_.empty()) {
+       requestReschedule();
+   }
+}
+
+/** Gives up the rest of the current process's time slice. */
+void Scheduler::yield()
+{
+   if (activeProcess_) {
+       activeProcess_->ticksLeft = 0;
+       requestReschedule();
+   }
+}
@@ -7,6 +7,7 @@
 #include <proc/elf/DataStructures.hpp>
 #include <Kernel.hpp>
 
+#include <algorithm>
 #include <utility>
 #include <cstring>
 #include <util/LinkedList.hpp>
@@ -210,6 +211,7 @@ size_t Executable::loadProgramSegments(size_t offset, size_t entryCount)
         segment.data = _file.bytes() + header.offset;
         segment.dataSize = header.sizeInFile;
         segment.memorySize = header.sizeInMemory;
+        segment.flags = header.flags;
         _segments.enqueue(std::move(segment));
     }
 
@@ -223,19 +225,24 @@ bool Executable::loadSegments()
     }
 
     sys::LinkedList<SegmentRAII> cleanup;
+    uintptr_t programEnd = 0;
     for (auto &ps : _segments) {
         if (ps.alignment == 0x1000) {
             size_t pages = ps.memorySize / 0x1000 + ((ps.memorySize % 0x1000) ? 1 : 0);
-            auto mem = kernel->palloc((void*)ps.vaddress, pages);
+            programEnd = std::max(programEnd, ps.vaddress + pages * 0x1000);
+            // pages are filled in from the file (or zeroed) as the program touches them
+            VirtualMemoryMap::Area area{.start = ps.vaddress,
+                                        .end = ps.vaddress + pages * 0x1000,
+                                        .protection = std::uint8_t(ps.flags & 0x7),
+                                        .backing = VirtualMemoryMap::Backing::kElfSegment,
+                                        .data = ps.data,
+                                        .dataSize = ps.dataSize};
+            auto mem = kernel->pallocLazy(area);
             if (!mem) {
                 return false;
             }
 
             cleanup.enqueue(SegmentRAII{mem, pages});
-            memset(mem, 0, ps.memorySize);
-            if (ps.dataSize) {
-                memcpy(mem, ps.data, ps.dataSize);
-            }
         }
     }
 
@@ -244,6 +251,7 @@ bool Executable::loadSegments()
         c.disarm();
     }
 
+    _heap = Heap{programEnd, X86::kKernelVirtualBase};
     _isLoaded = true;
 
     return true;
@@ -255,9 +263,15 @@ bool Executable::unloadSegments()
         return true; // already unloaded
     }
 
+    _heap.release();
+    _heap = Heap{0, 0};
+
     for (auto &ps : _segments) {
+        if (ps.alignment != 0x1000) {
+            continue;
+        }
         size_t pages = ps.memorySize / 0x1000 + ((ps.memorySize % 0x1000) ? 1 : 0);
-        if (kernel->pfree((void*)ps.vaddress, pages) != 0) {
+        if (kernel->unmap((void*)ps.vaddress, pages) != 0) {
             kernel->panic("Error freeing loaded ELF segment memory.");
         }
     }
@@ -266,4 +280,13 @@ bool Executable::unloadSegments()
     return true;
 }
 
+int Executable::run(int argc, char const *argv[])
+{
+    auto *callerHeap = kernel->heap();
+    kernel->setHeap(&_heap);
+    auto const status = _entry(argc, argv);
+    kernel->setHeap(callerHeap);
+    return status;
+}
+
 } // namespace elf
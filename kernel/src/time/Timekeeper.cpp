@@ -0,0 +1,80 @@
+#include <time/Timekeeper.hpp>
+
+#include <algorithm>
+
+void Timekeeper::install(TimerDevice &device)
+{
+    _device = &device;
+    _device->startPeriodic();
+    _mode = Mode::kPeriodic;
+}
+
+void Timekeeper::interrupt()
+{
+    switch (_mode) {
+        case Mode::kPeriodic:
+            advance(_device->cyclesPerTick());
+            break;
+        case Mode::kOneShot:
+            // the whole delay has passed; idle again, if the CPU is, re-arms it
+            advance(_armed);
+            _armed = 0;
+            _mode = Mode::kStopped;
+            break;
+        case Mode::kStopped:
+            break;
+    }
+}
+
+void Timekeeper::enterIdle()
+{
+    if (!_device) {
+        return;
+    }
+
+    if (_deadline == kNoDeadline) {
+        _device->stop();
+        _mode = Mode::kStopped;
+    } else {
+        armOneShot();
+    }
+}
+
+void Timekeeper::exitIdle()
+{
+    if (!_device || _mode == Mode::kPeriodic) {
+        return;
+    }
+
+    // woken before the one-shot fired: count the part of it that did pass
+    if (_mode == Mode::kOneShot) {
+        advance(_armed - std::min(_device->remaining(), _armed));
+        _armed = 0;
+    }
+
+    _device->startPeriodic();
+    _mode = Mode::kPeriodic;
+}
+
+void Timekeeper::advance(std::uint32_t cycles)
+{
+    auto const perTick = _device->cyclesPerTick();
+    auto const total = _residue + cycles;
+    _ticks += total / perTick;
+    _residue = total % perTick;
+}
+
+void Timekeeper::armOneShot()
+{
+    auto const perTick = _device->cyclesPerTick();
+    std::uint32_t cycles = 1;
+    if (_deadline > _ticks) {
+        // no further than the device reaches anyway, so this can't overflow
+        auto const ticksAway = std::min<std::uint64_t>(_deadline - _ticks, _device->maxOneShot() / perTick + 1);
+        cycles = std::uint32_t(ticksAway) * perTick - _residue;
+    }
+
+    _armed = std::clamp<std::uint32_t>(cycles, 1, _device->maxOneShot());
+    _device->startOneShot(_armed);
+    _mode = Mode::kOneShot;
+}
@@ -0,0 +1,123 @@
+#include <time/TimerWheel.hpp>
+
+#include <algorithm>
+
+void TimerWheel::add(Timer &timer, std::uint64_t expires)
+{
+    cancel(timer);
+    timer.expires = std::max(expires, _now + 1);
+    timer.pending = true;
+    insert(timer);
+    ++_pending;
+}
+
+void TimerWheel::cancel(Timer &timer)
+{
+    if (!timer.pending) {
+        return;
+    }
+
+    unlink(timer);
+    timer.pending = false;
+    --_pending;
+}
+
+void TimerWheel::advance(std::uint64_t tick)
+{
+    // nothing to fire or cascade on the way
+    if (empty()) {
+        _now = std::max(_now, tick);
+        return;
+    }
+
+    while (_now < tick) {
+        ++_now;
+
+        // a level coming full circle moves the next level's current slot down
+        for (std::size_t level = 1; level < kLevels && slotIndex(_now, level - 1) == 0; ++level) {
+            cascade(level, slotIndex(_now, level));
+        }
+
+        auto &slot = _slots[0][slotIndex(_now, 0)];
+        while (auto *timer = slot.head) {
+            cancel(*timer);
+            timer->callback(*timer);
+        }
+    }
+}
+
+std::uint64_t TimerWheel::nextExpiry() const
+{
+    auto earliest = kNever;
+    for (std::size_t level = 0; level < kLevels && !empty(); ++level) {
+        // a level's current slot has been dealt with this time round, so its timers are due next time
+        auto const current = slotIndex(_now, level);
+        auto found = _occupied[level].findFirstSet(current + 1);
+        bool wrapped = false;
+        if (found == sys::BitSet<kSlots>::kNotFound) {
+            found = _occupied[level].findFirstSet();
+            wrapped = true;
+        }
+        if (found == sys::BitSet<kSlots>::kNotFound) {
+            continue;
+        }
+
+        // when that slot comes round, which is no later than any of its timers
+        auto const span = std::uint64_t(1) << shiftOf(level);
+        auto const round = (_now >> shiftOf(level + 1)) << shiftOf(level + 1);
+        earliest = std::min(earliest, round + found * span + (wrapped ? span * kSlots : 0));
+    }
+
+    return earliest;
+}
+
+void TimerWheel::insert(Timer &timer)
+{
+    auto const delta = timer.expires - _now;
+    std::size_t level = 0;
+    while (level < kLevels - 1 && delta >= (std::uint64_t(1) << shiftOf(level + 1))) {
+        ++level;
+    }
+
+    // beyond the top level: park it in the last slot to come round before its time
+    auto const expires = delta >= (std::uint64_t(1) << shiftOf(kLevels)) ? _now + (std::uint64_t(kSlots - 1) << shiftOf(level))
+                                                                        : timer.expires;
+    timer.level = std::uint8_t(level);
+    timer.slot = std::uint8_t(slotIndex(expires, level));
+
+    auto &slot = _slots[level][timer.slot];
+    timer.next = nullptr;
+    timer.prev = slot.tail;
+    if (slot.tail) {
+        slot.tail->next = &timer;
+    } else {
+        slot.head = &timer;
+        _occupied[level].set(timer.slot);
+    }
+    slot.tail = &timer;
+}
+
+void TimerWheel::unlink(Timer &timer)
+{
+    auto &slot = _slots[timer.level][timer.slot];
+    (timer.prev ? timer.prev->next : slot.head) = timer.next;
+    (timer.next ? timer.next->prev : slot.tail) = timer.prev;
+    timer.next = timer.prev = nullptr;
+    if (!slot.head) {
+        _occupied[timer.level].unset(timer.slot);
+    }
+}
+
+void TimerWheel::cascade(std::size_t level, std::size_t slot)
+{
+    auto &from = _slots[level][slot];
+    auto *timer = from.head;
+    from.head = from.tail = nullptr;
+    _occupied[level].unset(slot);
+
+    while (timer) {
+        auto *next = timer->next;
+        insert(*timer);
+        timer = next;
+    }
+}
@@ -0,0 +1,191 @@
+#include "Test.hpp"
+
+#include <Kernel.hpp>
+#include <mem/KernelHeap.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr std::size_t const kPage = 0x1000;
+
+std::size_t classOf(void *block) { return SlabCache::cacheOf(block)->objectSize(); }
+
+bool alignedTo(void *block, std::size_t alignment) { return reinterpret_cast<std::uintptr_t>(block) % alignment == 0; }
+
+void picksTheSmallestClassThatFits()
+{
+    KernelHeap heap;
+    struct
+    {
+        std::size_t size;
+        std::size_t classSize;
+    } const cases[] = {{0, 16},    {1, 16},    {16, 16},   {17, 32},   {33, 48},   {48, 48},   {49, 64},
+                       {64, 64},   {65, 96},   {96, 96},   {97, 128},  {129, 192}, {192, 192}, {193, 256},
+                       {257, 384}, {384, 384}, {385, 512}, {513, 768}, {768, 768}, {769, 1024}, {1024, 1024}};
+    for (auto const &c : cases) {
+        void *block = heap.allocate(c.size);
+        CHECK(block != nullptr);
+        CHECK(!alignedTo(block, kPage));
+        CHECK(classOf(block) == c.classSize);
+        heap.free(block);
+    }
+
+    // every size up to the largest class, against the classes' own rule
+    for (std::size_t size = 1; size <= SlabCache::kMaxObjectSize; ++size) {
+        void *block = heap.allocate(size);
+        CHECK(classOf(block) >= size);
+        CHECK(classOf(block) < 2 * size || classOf(block) == 16);
+        heap.free(block);
+    }
+}
+
+void alignsBlocks()
+{
+    KernelHeap heap;
+    for (std::size_t size = 1; size <= SlabCache::kMaxObjectSize; size += 7) {
+        void *block = heap.allocate(size);
+        CHECK(alignedTo(block, 16));
+        heap.free(block);
+    }
+
+    // the class holding a multiple of the alignment is aligned at least that much
+    for (std::size_t alignment = 32; alignment <= 512; alignment *= 2) {
+        void *block = heap.allocateAligned(alignment, 24);
+        CHECK(alignedTo(block, alignment));
+        heap.free(block);
+    }
+
+    void *pageAligned = heap.allocateAligned(kPage, 100);
+    CHECK(alignedTo(pageAligned, kPage));
+    heap.free(pageAligned);
+
+    CHECK(heap.allocateAligned(24, 8) == nullptr);
+    CHECK(heap.allocateAligned(2 * kPage, 8) == nullptr);
+}
+
+void largeBlocksGetPagesOfTheirOwn()
+{
+    KernelHeap heap;
+    auto const pagesBefore = kernel->pagesInUse;
+    void *block = heap.allocate(SlabCache::kMaxObjectSize + 1);
+    CHECK(kernel->pagesInUse == pagesBefore + 1);
+
+    void *bigger = heap.allocate(3 * kPage);
+    CHECK(kernel->pagesInUse == pagesBefore + 5);
+
+    heap.free(block);
+    heap.free(bigger);
+    CHECK(kernel->pagesInUse == pagesBefore);
+}
+
+void keepsLargeBlocksThePageAllocatorRefuses()
+{
+    KernelHeap heap;
+    auto const pagesBefore = kernel->pagesInUse;
+    auto *block = static_cast<char *>(heap.allocate(2 * kPage));
+    std::memset(block, 'x', 2 * kPage);
+
+    kernel->failPfree = true;
+    heap.free(block);
+    kernel->failPfree = false;
+    CHECK(kernel->pagesInUse == pagesBefore + 3);
+    CHECK(block[0] == 'x');
+}
+
+void reallocateKeepsContents()
+{
+    KernelHeap heap;
+    auto *block = static_cast<char *>(heap.allocate(20));
+    std::memcpy(block, "0123456789abcdefghi", 20);
+
+    // still fits in its class
+    CHECK(heap.reallocate(block, 32) == block);
+
+    auto *moved = static_cast<char *>(heap.reallocate(block, 2000));
+    CHECK(moved != block);
+    CHECK(std::memcmp(moved, "0123456789abcdefghi", 20) == 0);
+
+    CHECK(heap.reallocate(moved, 0) == nullptr);
+}
+
+void allocateZeroedChecksOverflow()
+{
+    KernelHeap heap;
+    auto *block = static_cast<unsigned char *>(heap.allocateZeroed(10, 30));
+    bool zeroed = true;
+    for (std::size_t i = 0; i < 300; ++i) { zeroed = zeroed && block[i] == 0; }
+    CHECK(zeroed);
+    heap.free(block);
+
+    CHECK(heap.allocateZeroed(SIZE_MAX / 2, 3) == nullptr);
+}
+
+void failsWhenPagesRunOut()
+{
+    KernelHeap heap;
+    kernel->failPalloc = true;
+    CHECK(heap.allocate(40) == nullptr);
+    CHECK(heap.allocate(2 * kPage) == nullptr);
+    kernel->failPalloc = false;
+}
+
+void slabsGoBackWhenEmpty()
+{
+    SlabCache cache{"test", 256};
+    auto const pagesBefore = kernel->pagesInUse;
+
+    // enough objects for three slabs
+    void *objects[40];
+    for (auto &object : objects) { object = cache.alloc(); }
+    CHECK(cache.slabCount() == 3);
+    CHECK(cache.objectsInUse() == 40);
+
+    // one empty slab is kept for the next allocation, the rest go back
+    for (auto *object : objects) { cache.free(object); }
+    CHECK(cache.objectsInUse() == 0);
+    CHECK(cache.slabCount() == 1);
+    CHECK(kernel->pagesInUse == pagesBefore + 1);
+
+    cache.shrink();
+    CHECK(cache.slabCount() == 0);
+    CHECK(kernel->pagesInUse == pagesBefore);
+}
+
+void slabsThePageAllocatorRefusesStayEmpty()
+{
+    SlabCache cache{"test", 512};
+    void *objects[16];
+    for (auto &object : objects) { object = cache.alloc(); }
+    auto const slabs = cache.slabCount();
+
+    kernel->failPfree = true;
+    for (auto *object : objects) { cache.free(object); }
+    cache.shrink();
+    kernel->failPfree = false;
+    CHECK(cache.slabCount() == slabs);
+
+    // and they are reused
+    for (auto &object : objects) { object = cache.alloc(); }
+    CHECK(cache.slabCount() == slabs);
+    for (auto *object : objects) { cache.free(object); }
+    cache.shrink();
+    CHECK(cache.slabCount() == 0);
+}
+
+} // namespace
+
+int main()
+{
+    test::run("picksTheSmallestClassThatFits", picksTheSmallestClassThatFits);
+    test::run("alignsBlocks", alignsBlocks);
+    test::run("largeBlocksGetPagesOfTheirOwn", largeBlocksGetPagesOfTheirOwn);
+    test::run("keepsLargeBlocksThePageAllocatorRefuses", keepsLargeBlocksThePageAllocatorRefuses);
+    test::run("reallocateKeepsContents", reallocateKeepsContents);
+    test::run("allocateZeroedChecksOverflow", allocateZeroedChecksOverflow);
+    test::run("failsWhenPagesRunOut", failsWhenPagesRunOut);
+    test::run("slabsGoBackWhenEmpty", slabsGoBackWhenEmpty);
+    test::run("slabsThePageAllocatorRefusesStayEmpty", slabsThePageAllocatorRefusesStayEmpty);
+    return test::result();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdio>
+
+/**
+ * Just enough of a harness for the host-side tests: CHECK() reports every
+ * failed expectation with its location, and a test program's main() returns
+ * test::result(), which is non-zero if anything failed.
+ */
+namespace test {
+
+inline int failures = 0;
+
+inline void check(bool passed, char const *expression, char const *file, int line)
+{
+    if (!passed) {
+        std::printf("%s:%d: CHECK(%s) failed\n", file, line, expression);
+        ++failures;
+    }
+}
+
+/** Runs one test case, naming it if any of its checks fail. */
+template <typename Case>
+void run(char const *name, Case &&testCase)
+{
+    auto const before = failures;
+    testCase();
+    if (failures != before) {
+        std::printf("FAILED: %s\n", name);
+    }
+}
+
+inline int result()
+{
+    std::printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
+
+} // namespace test
+
+#define CHECK(expression) test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
@@ -0,0 +1,159 @@
+#include "Test.hpp"
+
+#include <time/TimerWheel.hpp>
+
+namespace {
+
+/** Remembers when a timer fired. */
+struct Record
+{
+    TimerWheel *wheel;
+    std::uint64_t firedAt = TimerWheel::kNever;
+    int fired = 0;
+};
+
+Timer timerFor(Record &record)
+{
+    return Timer{.callback = [](Timer &t) {
+                     auto &r = *static_cast<Record *>(t.context);
+                     r.firedAt = r.wheel->now();
+                     ++r.fired;
+                 },
+                 .context = &record};
+}
+
+/** Arms a timer `delta` ticks from now, and checks it fires on time and no earlier. */
+void checkFiresAfter(std::uint64_t start, std::uint64_t delta)
+{
+    TimerWheel wheel;
+    wheel.advance(start);
+    Record record{&wheel};
+    auto timer = timerFor(record);
+    wheel.add(timer, start + delta);
+
+    wheel.advance(start + delta - 1);
+    CHECK(record.fired == 0);
+    wheel.advance(start + delta);
+    CHECK(record.fired == 1);
+    CHECK(record.firedAt == start + delta);
+    CHECK(wheel.empty());
+}
+
+void firesOnTimeAtLevelBoundaries()
+{
+    constexpr std::uint64_t kLevel1 = TimerWheel::kSlots;
+    constexpr std::uint64_t kLevel2 = kLevel1 * TimerWheel::kSlots;
+    constexpr std::uint64_t kLevel3 = kLevel2 * TimerWheel::kSlots;
+    std::uint64_t const deltas[] = {1, kLevel1 - 1, kLevel1, kLevel1 + 1, kLevel2 - 1, kLevel2, kLevel2 + 1,
+                                    kLevel3 - 1, kLevel3, kLevel3 + 1};
+    for (auto const delta : deltas) {
+        checkFiresAfter(0, delta);
+        checkFiresAfter(5, delta);
+    }
+}
+
+void firesOnTimeAcrossWraps()
+{
+    // starting just short of a level coming full circle, so the expiry hashes to a lower slot
+    for (std::uint64_t start : {TimerWheel::kSlots - 3, TimerWheel::kSlots * TimerWheel::kSlots - 2}) {
+        for (std::uint64_t delta : {std::uint64_t(2), std::uint64_t(5), TimerWheel::kSlots + 7}) {
+            checkFiresAfter(start, delta);
+        }
+    }
+}
+
+void parksTimersBeyondTheTopLevel()
+{
+    constexpr std::uint64_t kReach = std::uint64_t(1) << (TimerWheel::kLevels * TimerWheel::kSlotBits);
+    checkFiresAfter(0, kReach);
+    checkFiresAfter(3, kReach + 1000);
+    checkFiresAfter(17, 2 * kReach + 5);
+}
+
+void firesPastExpiriesOnTheNextTick()
+{
+    TimerWheel wheel;
+    wheel.advance(100);
+    Record record{&wheel};
+    auto timer = timerFor(record);
+    wheel.add(timer, 50);
+    wheel.advance(101);
+    CHECK(record.firedAt == 101);
+}
+
+void cancelsAndRearms()
+{
+    TimerWheel wheel;
+    Record record{&wheel};
+    auto timer = timerFor(record);
+    wheel.add(timer, 10);
+    wheel.cancel(timer);
+    CHECK(wheel.empty());
+    wheel.advance(20);
+    CHECK(record.fired == 0);
+
+    // re-adding a pending timer moves it
+    wheel.add(timer, 100);
+    wheel.add(timer, 30);
+    wheel.advance(200);
+    CHECK(record.fired == 1);
+    CHECK(record.firedAt == 30);
+}
+
+void firesEverySlotMate()
+{
+    TimerWheel wheel;
+    Record records[3]{{&wheel}, {&wheel}, {&wheel}};
+    Timer timers[3]{timerFor(records[0]), timerFor(records[1]), timerFor(records[2])};
+    for (auto &timer : timers) { wheel.add(timer, 300); }
+    wheel.cancel(timers[1]);
+    wheel.advance(300);
+    CHECK(records[0].firedAt == 300);
+    CHECK(records[1].fired == 0);
+    CHECK(records[2].firedAt == 300);
+}
+
+void nextExpiryLeadsToTheTimer()
+{
+    TimerWheel wheel;
+    CHECK(wheel.nextExpiry() == TimerWheel::kNever);
+
+    Record near{&wheel};
+    auto nearTimer = timerFor(near);
+    wheel.add(nearTimer, 9);
+    CHECK(wheel.nextExpiry() == 9);
+    wheel.advance(9);
+    CHECK(wheel.nextExpiry() == TimerWheel::kNever);
+
+    // sleeping until each reported deadline, the way the idle loop does, arrives on time and never late
+    std::uint64_t const expiries[] = {75, 5000, 300000, std::uint64_t(1) << 25};
+    for (auto const expires : expiries) {
+        Record record{&wheel};
+        auto timer = timerFor(record);
+        wheel.add(timer, expires);
+        int wakeups = 0;
+        while (record.fired == 0 && wakeups < 1000) {
+            auto const next = wheel.nextExpiry();
+            CHECK(next > wheel.now());
+            CHECK(next <= expires);
+            wheel.advance(next);
+            ++wakeups;
+        }
+        CHECK(record.firedAt == expires);
+        CHECK(wakeups <= 8);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    test::run("firesOnTimeAtLevelBoundaries", firesOnTimeAtLevelBoundaries);
+    test::run("firesOnTimeAcrossWraps", firesOnTimeAcrossWraps);
+    test::run("parksTimersBeyondTheTopLevel", parksTimersBeyondTheTopLevel);
+    test::run("firesPastExpiriesOnTheNextTick", firesPastExpiriesOnTheNextTick);
+    test::run("cancelsAndRearms", cancelsAndRearms);
+    test::run("firesEverySlotMate", firesEverySlotMate);
+    test::run("nextExpiryLeadsToTheTimer", nextExpiryLeadsToTheTimer);
+    return test::result();
+}
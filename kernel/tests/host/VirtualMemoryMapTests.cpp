@@ -0,0 +1,89 @@
+#include "Test.hpp"
+
+#include <mem/VirtualMemoryMap.hpp>
+
+namespace {
+
+constexpr std::uintptr_t const kPage = 0x1000;
+
+VirtualMemoryMap::Area anonymous(std::uintptr_t start, std::uintptr_t end)
+{
+    return {.start = start, .end = end, .protection = VirtualMemoryMap::kProtRead | VirtualMemoryMap::kProtWrite};
+}
+
+void mergesAnonymousNeighbours()
+{
+    VirtualMemoryMap map;
+    CHECK(map.insert(anonymous(0, 2 * kPage)));
+    CHECK(map.insert(anonymous(4 * kPage, 6 * kPage)));
+    CHECK(map.insert(anonymous(2 * kPage, 4 * kPage)));
+    CHECK(map.size() == 1);
+    CHECK(map.find(5 * kPage)->start == 0);
+
+    // areas with data of their own stay apart
+    static std::byte const data[1]{};
+    auto withData = anonymous(6 * kPage, 7 * kPage);
+    withData.data = data;
+    withData.dataSize = sizeof(data);
+    CHECK(map.insert(withData));
+    CHECK(map.size() == 2);
+    CHECK(!map.insert(anonymous(5 * kPage, 8 * kPage)));
+}
+
+void coversOnlyMappedRanges()
+{
+    VirtualMemoryMap map;
+    CHECK(map.insert(anonymous(2 * kPage, 4 * kPage)));
+    auto other = anonymous(4 * kPage, 6 * kPage);
+    other.protection = VirtualMemoryMap::kProtRead;
+    CHECK(map.insert(other));
+    CHECK(map.insert(anonymous(8 * kPage, 9 * kPage)));
+
+    CHECK(map.covers(2 * kPage, 4 * kPage));
+    CHECK(map.covers(3 * kPage, 5 * kPage));
+    CHECK(map.covers(2 * kPage, 6 * kPage));
+    CHECK(!map.covers(kPage, 3 * kPage));
+    CHECK(!map.covers(5 * kPage, 7 * kPage));
+    CHECK(!map.covers(2 * kPage, 9 * kPage));
+    CHECK(!map.covers(6 * kPage, 8 * kPage));
+}
+
+void coversChecksAreaFlags()
+{
+    VirtualMemoryMap map;
+    auto mapped = anonymous(2 * kPage, 4 * kPage);
+    mapped.flags = VirtualMemoryMap::kAreaMapped;
+    CHECK(map.insert(mapped));
+    CHECK(map.insert(anonymous(4 * kPage, 6 * kPage)));
+    CHECK(map.size() == 2);
+
+    CHECK(map.covers(2 * kPage, 4 * kPage, VirtualMemoryMap::kAreaMapped));
+    CHECK(map.covers(2 * kPage, 6 * kPage));
+    CHECK(!map.covers(2 * kPage, 6 * kPage, VirtualMemoryMap::kAreaMapped));
+    CHECK(!map.covers(4 * kPage, 5 * kPage, VirtualMemoryMap::kAreaMapped));
+}
+
+void removeTrimsAndSplits()
+{
+    VirtualMemoryMap map;
+    CHECK(map.insert(anonymous(0, 8 * kPage)));
+    CHECK(map.remove(2 * kPage, 3 * kPage));
+    CHECK(map.size() == 2);
+    CHECK(!map.covers(2 * kPage, 3 * kPage));
+    CHECK(map.covers(3 * kPage, 8 * kPage));
+
+    CHECK(map.remove(kPage, 4 * kPage));
+    CHECK(map.find(0)->end == kPage);
+    CHECK(map.find(4 * kPage)->start == 4 * kPage);
+}
+
+} // namespace
+
+int main()
+{
+    test::run("mergesAnonymousNeighbours", mergesAnonymousNeighbours);
+    test::run("coversOnlyMappedRanges", coversOnlyMappedRanges);
+    test::run("coversChecksAreaFlags", coversChecksAreaFlags);
+    test::run("removeTrimsAndSplits", removeTrimsAndSplits);
+    return test::result();
+}
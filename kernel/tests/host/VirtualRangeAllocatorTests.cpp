@@ -0,0 +1,110 @@
+#include "Test.hpp"
+
+#include <mem/VirtualRangeAllocator.hpp>
+
+namespace {
+
+constexpr std::uintptr_t const kPage = 0x1000;
+constexpr std::uintptr_t const kBegin = 0x100000;
+constexpr std::uintptr_t const kEnd = kBegin + 64 * kPage;
+
+void allocatesLowestHoleFirst()
+{
+    VirtualRangeAllocator ranges{kBegin, kEnd};
+    CHECK(ranges.freePages() == 64);
+    CHECK(ranges.allocate(4) == kBegin);
+    CHECK(ranges.allocate(4) == kBegin + 4 * kPage);
+    CHECK(ranges.freePages() == 56);
+
+    CHECK(ranges.release(kBegin, 4));
+    CHECK(ranges.allocate(2) == kBegin);
+    CHECK(ranges.allocate(3) == kBegin + 8 * kPage);
+}
+
+void alignsAllocations()
+{
+    VirtualRangeAllocator ranges{kBegin, kEnd};
+    CHECK(ranges.allocate(1) == kBegin);
+
+    // the aligned range comes from the middle of the extent, splitting it
+    auto const aligned = ranges.allocate(8, 8);
+    CHECK(aligned == kBegin + 8 * kPage);
+    CHECK(ranges.freePages() == 55);
+    CHECK(ranges.allocate(7) == kBegin + kPage);
+}
+
+void reservesOnlyFreeRanges()
+{
+    VirtualRangeAllocator ranges{kBegin, kEnd};
+    CHECK(ranges.reserve(kBegin + 10 * kPage, 5));
+    CHECK(!ranges.reserve(kBegin + 12 * kPage, 1));
+    CHECK(!ranges.reserve(kBegin + 8 * kPage, 4));
+    CHECK(!ranges.reserve(kEnd - kPage, 2));
+    CHECK(ranges.freePages() == 59);
+}
+
+void releaseMergesNeighbours()
+{
+    VirtualRangeAllocator ranges{kBegin, kEnd};
+    CHECK(ranges.allocate(64) == kBegin);
+    CHECK(ranges.release(kBegin, 2));
+    CHECK(ranges.release(kBegin + 4 * kPage, 2));
+    CHECK(ranges.release(kBegin + 2 * kPage, 2));
+
+    // one extent of six pages again, so six pages fit in one go
+    CHECK(ranges.allocate(6) == kBegin);
+    CHECK(ranges.freePages() == 0);
+}
+
+void releaseRejectsOverlap()
+{
+    VirtualRangeAllocator ranges{kBegin, kEnd};
+    CHECK(ranges.allocate(8) == kBegin);
+    CHECK(ranges.release(kBegin + 2 * kPage, 2));
+
+    // twice, straddling either end of a free extent, or covering it whole
+    CHECK(!ranges.release(kBegin + 2 * kPage, 2));
+    CHECK(!ranges.release(kBegin + kPage, 2));
+    CHECK(!ranges.release(kBegin + 3 * kPage, 2));
+    CHECK(!ranges.release(kBegin, 8));
+    CHECK(!ranges.release(kBegin + 7 * kPage, 2));
+    CHECK(ranges.freePages() == 58);
+
+    // nothing is handed out twice
+    CHECK(ranges.allocate(2) == kBegin + 2 * kPage);
+    CHECK(ranges.allocate(1) == kBegin + 8 * kPage);
+}
+
+void releaseFailsWhenFull()
+{
+    constexpr auto kExtents = VirtualRangeAllocator::kMaxExtents;
+    VirtualRangeAllocator ranges{kBegin, kBegin + (2 * kExtents + 2) * kPage};
+    CHECK(ranges.allocate(2 * kExtents + 2) == kBegin);
+
+    // every other page free, for as many extents as fit
+    for (std::size_t i = 0; i < kExtents; ++i) {
+        CHECK(ranges.release(kBegin + 2 * i * kPage, 1));
+    }
+
+    auto const lonely = kBegin + (2 * kExtents + 1) * kPage;
+    CHECK(!ranges.release(lonely, 1));
+    CHECK(ranges.freePages() == kExtents);
+
+    // filling a gap joins two extents, which makes room
+    CHECK(ranges.release(kBegin + kPage, 1));
+    CHECK(ranges.release(lonely, 1));
+    CHECK(ranges.freePages() == kExtents + 2);
+}
+
+} // namespace
+
+int main()
+{
+    test::run("allocatesLowestHoleFirst", allocatesLowestHoleFirst);
+    test::run("alignsAllocations", alignsAllocations);
+    test::run("reservesOnlyFreeRanges", reservesOnlyFreeRanges);
+    test::run("releaseMergesNeighbours", releaseMergesNeighbours);
+    test::run("releaseRejectsOverlap", releaseRejectsOverlap);
+    test::run("releaseFailsWhenFull", releaseFailsWhenFull);
+    return test::result();
+}
@@ -0,0 +1,34 @@
+#include <Kernel.hpp>
+
+#include <cstdlib>
+
+namespace {
+
+constexpr std::size_t const kPageSize = 0x1000;
+
+Kernel g_kernel;
+
+} // namespace
+
+Kernel *kernel = &g_kernel;
+
+void *Kernel::palloc(std::size_t numberOfPages)
+{
+    if (failPalloc) {
+        return nullptr;
+    }
+
+    pagesInUse += numberOfPages;
+    return std::aligned_alloc(kPageSize, numberOfPages * kPageSize);
+}
+
+int Kernel::pfree(void *startOfMemoryRange, std::size_t numberOfPages)
+{
+    if (failPfree) {
+        return -1;
+    }
+
+    pagesInUse -= numberOfPages;
+    std::free(startOfMemoryRange);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Stands in for the kernel in host tests. Pages come from the host's heap,
+ * and the tests can make the page allocator fail.
+ */
+class Kernel
+{
+  public:
+    void *palloc(std::size_t numberOfPages);
+    int pfree(void *startOfMemoryRange, std::size_t numberOfPages = 1);
+
+    std::size_t pagesInUse = 0;
+    bool failPalloc = false;
+    bool failPfree = false;
+};
+
+extern Kernel *kernel;
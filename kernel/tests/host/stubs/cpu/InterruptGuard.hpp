@@ -0,0 +1,12 @@
+#pragma once
+
+/** Host tests run in user mode, where there are no interrupts to disable. */
+class InterruptGuard
+{
+  public:
+    InterruptGuard() {}
+    ~InterruptGuard() {}
+
+    InterruptGuard(InterruptGuard const &) = delete;
+    InterruptGuard &operator=(InterruptGuard const &) = delete;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <io/OutputStream.hpp>
+
+/** The formatter depends on the kernel's libc, so host tests print nothing. */
+namespace sys {
+
+template <typename... Ts>
+void println(OutputStream &, char const *, Ts &&...)
+{}
+
+} // namespace sys
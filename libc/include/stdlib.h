@@ -93,6 +93,15 @@ void *realloc(void *ptr, size_t size);
  */
 void *calloc(size_t num, size_t size);
 
+/**
+ * Allocates a block of memory of `size` bytes aligned to `alignment`.
+ * @param alignment The alignment, a power of two no bigger than a page (4096).
+ * @param size The size of the memory block to allocate.
+ * @return A pointer to the allocated block, or NULL if it failed or the
+ *         alignment isn't supported. Free it with free().
+ */
+void *aligned_alloc(size_t alignment, size_t size);
+
 /**
  * Frees a previously allocated block of memory.
  * @param ptr The pointer to the memory block to free.
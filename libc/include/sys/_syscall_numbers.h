@@ -7,7 +7,7 @@ __BEGIN_DECLS
 
 typedef struct syscall_identifiers
 {
-    enum { kOpen, kRead, kWrite, kClose, kExit, kSleep, kYield, kDie };
+    enum { kOpen, kRead, kWrite, kClose, kExit, kSleep, kYield, kDie, kSbrk, kMmap, kMunmap, kNanosleep, kHeapProfile };
 } SyscallId;
 
 __END_DECLS
@@ -12,10 +12,33 @@ __BEGIN_DECLS
 DECL_SYSCALL1(exit, int);
 DECL_SYSCALL3(write, uint32_t, uint8_t const *, size_t);
 DECL_SYSCALL3(read, uint32_t, uint8_t *, size_t);
+/** Blocks for at least the given number of seconds. */
 DECL_SYSCALL1(sleep, int);
+
+/**
+ * Blocks for at least the given time. The nanoseconds must be below a second.
+ * Returns 0, or -1 on error.
+ */
+DECL_SYSCALL2(nanosleep, uint32_t, uint32_t);
 DECL_SYSCALL0(yield);
 DECL_SYSCALL0(die);
 
+/** Moves the program break. Returns the previous break, or -1 on error. */
+DECL_SYSCALL1(sbrk, intptr_t);
+
+/**
+ * Maps zero-filled, read-write memory, page by page as it is first touched.
+ * The address must be page aligned, or NULL to let the kernel choose one.
+ * Returns the address of the mapping, or -1 on error.
+ */
+DECL_SYSCALL2(mmap, void *, size_t);
+
+/** Unmaps memory from sys_mmap(). Returns 0, or -1 on error. */
+DECL_SYSCALL2(munmap, void *, size_t);
+
+/** Writes the kernel heap profile to the debug console. Returns 0. */
+DECL_SYSCALL0(heapprof);
+
 __END_DECLS
 
 #endif //LAMBOS_SYSCALL_H
@@ -9,8 +9,9 @@
 #define VERSION    "1.1"
 #define ALIGNMENT    16ul//4ul				///< This is the byte alignment that memory must be allocated on. IMPORTANT for GTK and other stuff.
 
-#define ALIGN_TYPE        char ///unsigned char[16] /// unsigned short
-#define ALIGN_INFO        sizeof(ALIGN_TYPE)*16    ///< Alignment information is stored right before the pointer. This is the number of bytes of information stored there.
+#define ALIGN_TYPE        uint32_t ///< Wide enough for the offsets aligned_alloc() records.
+#define ALIGN_INFO        16ul    ///< Alignment information is stored right before the pointer. This is the number of bytes of information stored there.
+#define MAX_ALIGNMENT    4096ul    ///< The strictest alignment aligned_alloc() provides.
 
 
 #define USE_CASE1
@@ -41,7 +42,7 @@
         if ( ALIGNMENT > 1 )                                                    \
         {                                                                       \
             uintptr_t diff = *((ALIGN_TYPE*)((uintptr_t)ptr - ALIGN_INFO));     \
-            if ( diff < (ALIGNMENT + ALIGN_INFO) )                              \
+            if ( diff < (MAX_ALIGNMENT + ALIGNMENT + ALIGN_INFO) )              \
             {                                                                   \
                 ptr = (void*)((uintptr_t)ptr - diff);                           \
             }                                                                   \
@@ -695,6 +696,36 @@ void *PREFIX(calloc)(size_t nobj, size_t size)
 }
 
 
+void *PREFIX(aligned_alloc)(size_t alignment, size_t size)
+{
+    void *p;
+    uintptr_t shift;
+    struct liballoc_minor *min;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > MAX_ALIGNMENT) return NULL;
+    if (alignment <= ALIGNMENT) return PREFIX(malloc)(size);
+
+    // Take enough to slide the block up to the next boundary. The slide is a
+    // multiple of ALIGNMENT, so the alignment information still fits in front.
+    p = PREFIX(malloc)(size + alignment - ALIGNMENT);
+    if (p == NULL) return NULL;
+
+    shift = (alignment - ((uintptr_t) p & (alignment - 1))) & (alignment - 1);
+    if (shift != 0) {
+        uintptr_t diff = *((ALIGN_TYPE*)((uintptr_t)p - ALIGN_INFO)) + shift;
+        min = (struct liballoc_minor *) ((uintptr_t) p - (diff - shift) - sizeof(struct liballoc_minor));
+        p = (void*)((uintptr_t)p + shift);
+        *((ALIGN_TYPE*)((uintptr_t)p - ALIGN_INFO)) = diff;
+    } else {
+        min = (struct liballoc_minor *) ((uintptr_t) p - *((ALIGN_TYPE*)((uintptr_t)p - ALIGN_INFO)) - sizeof(struct liballoc_minor));
+    }
+
+    // realloc() copies req_size bytes from the block, so it must not count the slack
+    min->req_size = size;
+    return p;
+}
+
+
 void *PREFIX(realloc)(void *p, size_t size)
 {
     void *ptr;
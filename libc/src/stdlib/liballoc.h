@@ -67,6 +67,7 @@ extern void *PREFIX(malloc)(size_t);                ///< The standard function.
 extern void *PREFIX(realloc)(void *, size_t);       ///< The standard function.
 extern void *PREFIX(calloc)(size_t, size_t);        ///< The standard function.
 extern void  PREFIX(free)(void *);                  ///< The standard function.
+extern void *PREFIX(aligned_alloc)(size_t, size_t); ///< The standard function.
 
 #ifdef __cplusplus
 }
@@ -3,11 +3,19 @@
 //
 
 #include <decl.h>
+#include <sys/syscall.h>
 #include "liballoc.h"
 
-#ifdef KERNEL
-#include <Kernel.hpp>
-#endif
+// liballoc asks for memory in chunks of at least 16 pages, so most mallocs are
+// served without a syscall. The chunks come from the program break, which the
+// kernel gives back when the program is unloaded.
+
+namespace {
+
+constexpr intptr_t kPageSize = 0x1000;
+constexpr int kError = -1;
+
+}
 
 __BEGIN_DECLS
 
@@ -15,12 +23,28 @@ int liballoc_lock() { return 0; }
 
 int liballoc_unlock() { return 0; }
 
-#ifdef KERNEL
-void *liballoc_alloc(size_t numPages) { return kernel->palloc(numPages); }
-int liballoc_free(void *ptr, size_t numPages) { return kernel->pfree(ptr, numPages); }
-#else
-void *liballoc_alloc([[maybe_unused]] size_t numPages) { return nullptr; }
-int liballoc_free([[maybe_unused]] void *ptr, [[maybe_unused]] size_t numPages) { return 0; }
-#endif
+void *liballoc_alloc(size_t numPages)
+{
+    // keep the chunks page aligned, even if someone else moved the break
+    auto const misalignment = sys_sbrk(0) & (kPageSize - 1);
+    if (misalignment && sys_sbrk(kPageSize - misalignment) == kError) {
+        return nullptr;
+    }
+
+    auto const chunk = sys_sbrk(static_cast<intptr_t>(numPages) * kPageSize);
+    return chunk == kError ? nullptr : reinterpret_cast<void *>(chunk);
+}
+
+int liballoc_free(void *ptr, size_t numPages)
+{
+    // only the chunk at the top of the heap can go back; any other stays with
+    // the program until it exits
+    auto const size = static_cast<intptr_t>(numPages) * kPageSize;
+    if (reinterpret_cast<intptr_t>(ptr) + size == sys_sbrk(0)) {
+        return sys_sbrk(-size) == kError ? 1 : 0;
+    }
+
+    return 0;
+}
 
 __END_DECLS
@@ -14,8 +14,13 @@ DEFN_SYSCALL1(exit, SyscallId::kExit, int);
 DEFN_SYSCALL3(write, SyscallId::kWrite, uint32_t, uint8_t const *, size_t);
 DEFN_SYSCALL3(read, SyscallId::kRead, uint32_t, uint8_t *, size_t);
 DEFN_SYSCALL1(sleep, SyscallId::kSleep, int);
+DEFN_SYSCALL2(nanosleep, SyscallId::kNanosleep, uint32_t, uint32_t);
 DEFN_SYSCALL0(yield, SyscallId::kYield);
 DEFN_SYSCALL0(die, SyscallId::kDie);
+DEFN_SYSCALL1(sbrk, SyscallId::kSbrk, intptr_t);
+DEFN_SYSCALL2(mmap, SyscallId::kMmap, void *, size_t);
+DEFN_SYSCALL2(munmap, SyscallId::kMunmap, void *, size_t);
+DEFN_SYSCALL0(heapprof, SyscallId::kHeapProfile);
 
 } // extern "C"
 
@@ -45,8 +45,38 @@ int sys_sleep(int status)
     return (int)Syscall::sleep((X86Kernel&)*kernel, registers);
 }
 
+int sys_nanosleep(uint32_t seconds, uint32_t nanoseconds)
+{
+    auto registers = fake_syscall(seconds, nanoseconds);
+    return (int)Syscall::nanosleep((X86Kernel&)*kernel, registers);
+}
+
 int sys_yield() { return 0; }
 
+int sys_sbrk(intptr_t increment)
+{
+    auto registers = fake_syscall((uint32_t)increment);
+    return (int)Syscall::sbrk((X86Kernel&)*kernel, registers);
+}
+
+int sys_mmap(void *address, size_t length)
+{
+    auto registers = fake_syscall((uint32_t)address, length);
+    return (int)Syscall::mmap((X86Kernel&)*kernel, registers);
+}
+
+int sys_munmap(void *address, size_t length)
+{
+    auto registers = fake_syscall((uint32_t)address, length);
+    return (int)Syscall::munmap((X86Kernel&)*kernel, registers);
+}
+
+int sys_heapprof()
+{
+    auto registers = fake_syscall();
+    return (int)Syscall::heapProfile((X86Kernel&)*kernel, registers);
+}
+
 int sys_die()
 {
     auto registers = fake_syscall();
@@ -11,27 +11,39 @@ __BEGIN_DECLS
 void *kmalloc(size_t);                ///< The standard function.
 void *krealloc(void *, size_t);       ///< The standard function.
 void *kcalloc(size_t, size_t);        ///< The standard function.
+void *kmemalign(size_t, size_t);      ///< Like aligned_alloc.
 void  kfree(void *);                  ///< The standard function.
+void *kmalloc_from(size_t, void const *);           ///< kmalloc, charged to the given caller.
+void *kmemalign_from(size_t, size_t, void const *); ///< kmemalign, charged to the given caller.
 __END_DECLS
 #endif
 
 #ifndef KERNEL
 #define MALLOC std::malloc
+#define MEMALIGN std::aligned_alloc
 #define FREE   std::free
+#elif defined(LAMBOS_HEAP_PROFILER)
+// charge allocations to whoever called new, not to new itself
+#define MALLOC(size) kmalloc_from(size, __builtin_return_address(0))
+#define MEMALIGN(alignment, size) kmemalign_from(alignment, size, __builtin_return_address(0))
+#define FREE   kfree
 #else
 #define MALLOC kmalloc
+#define MEMALIGN kmemalign
 #define FREE   kfree
 #endif
 
+namespace std { const nothrow_t nothrow{}; }
+
 void *operator new  (std::size_t size) { return MALLOC(size); }
 void *operator new[](std::size_t size) { return MALLOC(size); }
-void *operator new  (std::size_t size, [[maybe_unused]] std::align_val_t alignment) { return MALLOC(size); }
-void *operator new[](std::size_t size, [[maybe_unused]] std::align_val_t alignment) { return MALLOC(size); }
+void *operator new  (std::size_t size, std::align_val_t alignment) { return MEMALIGN(static_cast<std::size_t>(alignment), size); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return MEMALIGN(static_cast<std::size_t>(alignment), size); }
 
 void *operator new  (std::size_t size, const std::nothrow_t&) noexcept { return MALLOC(size); }
 void *operator new[](std::size_t size, const std::nothrow_t&) noexcept { return MALLOC(size); }
-void *operator new  (std::size_t size, [[maybe_unused]] std::align_val_t alignment, const std::nothrow_t&) noexcept { return MALLOC(size); }
-void *operator new[](std::size_t size, [[maybe_unused]] std::align_val_t alignment, const std::nothrow_t&) noexcept { return MALLOC(size); }
+void *operator new  (std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return MEMALIGN(static_cast<std::size_t>(alignment), size); }
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return MEMALIGN(static_cast<std::size_t>(alignment), size); }
 
 void operator delete  (void* ptr) noexcept { FREE(ptr); }
 void operator delete[](void* ptr) noexcept { FREE(ptr); }
@@ -5,5 +5,6 @@
 #pragma once
 
 #include <mem/ArcPtr.hpp>
+#include <mem/ObjectAllocator.hpp>
 #include <mem/UniquePtr.hpp>
 #include <mem/Units.hpp>
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <mem/ObjectAllocator.hpp>
 #include <mem/RefCount.hpp>
 #include <mem/UniquePtr.hpp>
 #include <util/Void.hpp>
@@ -112,7 +113,7 @@ class ArcRefCount
     };
 
     template <typename U>
-    struct model_t : concept_t
+    struct model_t : concept_t, PoolAllocated
     {
         RefCount<U> impl;
 
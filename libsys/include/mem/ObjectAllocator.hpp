@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace sys {
+
+/**
+ * Allocation hook for small, fixed-size objects such as container nodes and
+ * reference count blocks.
+ *
+ * Types opt in by deriving from PoolAllocated, which sends their `new` and
+ * `delete` through the installed ObjectAllocator. The kernel installs one
+ * backed by slab caches. Without one, the objects come from the general heap.
+ *
+ * The allocator has to be installed before the first opted in object is
+ * allocated and must not change afterwards, since objects are handed back to
+ * whichever allocator is installed when they are deleted.
+ */
+class ObjectAllocator
+{
+  public:
+    virtual ~ObjectAllocator() = default;
+
+    /**
+     * Allocates memory for an object.
+     * @param size The size of the object, in bytes.
+     * @return The memory, or nullptr.
+     */
+    virtual void *allocate(std::size_t size) noexcept = 0;
+
+    /**
+     * Frees memory from allocate().
+     * @param object The memory.
+     * @param size The size it was allocated with.
+     */
+    virtual void deallocate(void *object, std::size_t size) noexcept = 0;
+
+    [[nodiscard]] static ObjectAllocator *installed() noexcept { return s_installed; }
+    static void install(ObjectAllocator *allocator) noexcept { s_installed = allocator; }
+
+  private:
+    static inline ObjectAllocator *s_installed = nullptr;
+};
+
+/** Base class for types whose instances are allocated through the ObjectAllocator. */
+class PoolAllocated
+{
+  public:
+    static void *operator new(std::size_t bytes) noexcept
+    {
+        auto *allocator = ObjectAllocator::installed();
+        return allocator ? allocator->allocate(bytes) : ::operator new(bytes, std::nothrow);
+    }
+
+    /** Placement new, which the class-specific new above would otherwise hide. */
+    static void *operator new(std::size_t, void *place) noexcept { return place; }
+
+    static void operator delete(void *object, std::size_t bytes) noexcept
+    {
+        if (auto *allocator = ObjectAllocator::installed()) {
+            allocator->deallocate(object, bytes);
+        } else {
+            ::operator delete(object);
+        }
+    }
+};
+
+} // namespace sys
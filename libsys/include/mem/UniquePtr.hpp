@@ -5,6 +5,7 @@
 #pragma once
 
 #include <concepts>
+#include <utility>
 
 namespace sys {
 
@@ -11,6 +11,23 @@ static inline void halt() { asm volatile("hlt"); }
 static inline void cli() { asm volatile ("cli"); }
 static inline void sti() { asm volatile ("sti"); }
 
+/** Enables interrupts and halts until the next one. sti only takes effect after hlt, so none can slip in between. */
+static inline void sti_halt() { asm volatile("sti\n\thlt" ::: "memory"); }
+
+/** Disables interrupts, returning the previous EFLAGS to hand to irq_restore(). */
+static inline uint32_t irq_save(void)
+{
+    uint32_t flags;
+    asm volatile( "pushf\n\tpop %0\n\tcli" : "=r"(flags) : : "memory" );
+    return flags;
+}
+
+/** Restores the interrupt flag saved by irq_save(). */
+static inline void irq_restore(uint32_t flags)
+{
+    asm volatile( "push %0\n\tpopf" : : "r"(flags) : "memory", "cc" );
+}
+
 static inline void outb(int intPort, uint8_t val)
 {
     uint16_t port = (uint16_t)intPort;
@@ -38,6 +55,18 @@ static inline void cpuid(int32_t code, uint32_t *a, uint32_t *d)
                   : "=a"(*a), "=d"(*d) : "0"(code) : "ebx", "ecx");
 }
 
+static inline uint32_t read_cr4(void)
+{
+    uint32_t val;
+    asm volatile( "mov %%cr4, %0" : "=r"(val) );
+    return val;
+}
+
+static inline void write_cr4(uint32_t val)
+{
+    asm volatile( "mov %0, %%cr4" : : "r"(val) : "memory" );
+}
+
 static inline uint8_t inb(int intPort)
 {
     uint16_t port = (uint16_t)intPort;
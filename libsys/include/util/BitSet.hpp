@@ -5,6 +5,8 @@
 #pragma once
 
 #include <math/Math.hpp>
+
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include <limits>
@@ -15,6 +17,7 @@ template <std::size_t SizeBits>
 class BitSet {
     using StoreUnit = unsigned int;
     static constexpr inline std::size_t kBPU = 8 * sizeof(StoreUnit);
+    static constexpr inline StoreUnit kAllOnes = std::numeric_limits<StoreUnit>::max();
 
     class ProxyBit
     {
@@ -29,6 +32,9 @@ class BitSet {
     };
 
   public:
+    /** Returned by the find functions when no matching bit exists. */
+    static constexpr inline std::size_t kNotFound = SizeBits;
+
     constexpr BitSet() : BitSet(false) {}
     constexpr explicit BitSet(bool initial) { std::memset(_bits, initial ? 0xFF : 0, size()); }
 
@@ -55,15 +61,143 @@ class BitSet {
         return prev;
     }
 
+    /**
+     * Sets `count` bits starting at `first`. Whole words are written at once.
+     * @param first The first bit to set.
+     * @param count The number of bits to set.
+     */
+    constexpr void setRange(std::size_t first, std::size_t count) { fillRange(first, count, true); }
+
+    /**
+     * Clears `count` bits starting at `first`. Whole words are written at once.
+     * @param first The first bit to clear.
+     * @param count The number of bits to clear.
+     */
+    constexpr void clearRange(std::size_t first, std::size_t count) { fillRange(first, count, false); }
+
+    /**
+     * Finds the first set bit at or after `from`.
+     * @return The index of the bit, or kNotFound if there is none.
+     */
+    [[nodiscard]]
+    constexpr std::size_t findFirstSet(std::size_t from = 0) const { return find(from, StoreUnit{0}); }
+
+    /**
+     * Finds the first clear bit at or after `from`.
+     * @return The index of the bit, or kNotFound if there is none.
+     */
+    [[nodiscard]]
+    constexpr std::size_t findFirstClear(std::size_t from = 0) const { return find(from, kAllOnes); }
+
+    /**
+     * Finds a run of `length` consecutive clear bits. The search starts at
+     * `hint` and wraps around to the beginning if nothing is found past it.
+     * @param length The number of clear bits needed.
+     * @param hint Where to start looking.
+     * @return The index of the first bit of the run, or kNotFound.
+     */
+    [[nodiscard]]
+    constexpr std::size_t findClearRun(std::size_t length, std::size_t hint = 0) const
+    {
+        if (length == 0 || length > SizeBits) { return kNotFound; }
+        if (hint >= SizeBits) { hint = 0; }
+
+        auto result = findClearRunIn(length, hint, SizeBits);
+        if (result == kNotFound && hint > 0) {
+            // runs may straddle the hint, so overlap the second pass with it
+            result = findClearRunIn(length, 0, std::min(hint + length - 1, SizeBits));
+        }
+
+        return result;
+    }
+
+    /** The number of set bits. */
+    [[nodiscard]]
+    constexpr std::size_t count() const
+    {
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < kUnits; ++i) {
+            total += std::size_t(__builtin_popcount(_bits[i] & validMask(i)));
+        }
+
+        return total;
+    }
+
     [[nodiscard]] constexpr std::size_t size() const { return sizeof(_bits); }
 
   private:
+    static constexpr inline std::size_t kUnits = div_ceil(SizeBits, kBPU);
+
     [[nodiscard]]
     constexpr StoreUnit bitmask(std::size_t bit) const { return static_cast<StoreUnit>(1 << (bit % kBPU)); }
 
+    /** Mask of bits [from, kBPU) within a unit. */
+    [[nodiscard]]
+    static constexpr StoreUnit maskFrom(std::size_t from) { return StoreUnit(kAllOnes << from); }
+
+    /** Mask of the bits in unit `unit` which actually belong to the set. */
+    [[nodiscard]]
+    static constexpr StoreUnit validMask(std::size_t unit)
+    {
+        std::size_t const tail = SizeBits % kBPU;
+        return (tail != 0 && unit == kUnits - 1) ? StoreUnit(~maskFrom(tail)) : kAllOnes;
+    }
+
+    /** Finds the first bit at or after `from` that differs from `skip` (all-zeros or all-ones). */
+    [[nodiscard]]
+    constexpr std::size_t find(std::size_t from, StoreUnit skip) const
+    {
+        if (from >= SizeBits) { return kNotFound; }
+
+        std::size_t unit = from / kBPU;
+        StoreUnit bits = StoreUnit(_bits[unit] ^ skip) & maskFrom(from % kBPU);
+        while (true) {
+            bits &= validMask(unit);
+            if (bits != 0) {
+                return unit * kBPU + std::size_t(__builtin_ctz(bits));
+            }
+
+            if (++unit == kUnits) { return kNotFound; }
+            bits = _bits[unit] ^ skip;
+        }
+    }
+
+    /** findClearRun, restricted to runs lying entirely within [from, to). */
+    [[nodiscard]]
+    constexpr std::size_t findClearRunIn(std::size_t length, std::size_t from, std::size_t to) const
+    {
+        while (from < to) {
+            std::size_t const start = findFirstClear(from);
+            if (start == kNotFound || start + length > to) { return kNotFound; }
+
+            std::size_t const end = std::min(findFirstSet(start), to);
+            if (end - start >= length) { return start; }
+
+            from = end;
+        }
+
+        return kNotFound;
+    }
+
+    constexpr void fillRange(std::size_t first, std::size_t count, bool value)
+    {
+        if (count == 0) { return; }
+
+        std::size_t const last = first + count; // exclusive
+        std::size_t unit = first / kBPU;
+        std::size_t const lastUnit = (last - 1) / kBPU;
+        StoreUnit mask = maskFrom(first % kBPU);
+        for (; unit <= lastUnit; ++unit, mask = kAllOnes) {
+            if (unit == lastUnit && last % kBPU != 0) {
+                mask &= StoreUnit(~maskFrom(last % kBPU));
+            }
+            _bits[unit] = value ? StoreUnit(_bits[unit] | mask) : StoreUnit(_bits[unit] & ~mask);
+        }
+    }
+
     [[nodiscard]] constexpr StoreUnit& unitForBit(std::size_t bit) { return _bits[bit/kBPU]; }
     [[nodiscard]] constexpr StoreUnit unitForBit(std::size_t bit) const { return _bits[bit/kBPU]; }
-    StoreUnit _bits[div_ceil(SizeBits, kBPU)];
+    StoreUnit _bits[kUnits];
 };
 
-} // namespace sys
\ No newline at end of file
+} // namespace sys
@@ -298,7 +298,7 @@ template <typename T> class LinkedList
     iterator end() { return iterator{LLIteratorImpl{nullptr, this}}; }
 
   private:
-    struct Node
+    struct Node : PoolAllocated
     {
         Node(const T &v) : value(v) {}
         Node(T &&v) : value(std::move(v)) {}
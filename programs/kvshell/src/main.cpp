@@ -12,6 +12,7 @@ enum class Command {
     kEcho,
     kSleep,
     kDie,
+    kHeapProfile,
     kUnknown
 };
 
@@ -66,6 +67,12 @@ void sleep(char const *str)
     sys_sleep(secs);
 }
 
+void heapProfile()
+{
+    sys_heapprof();
+    puts("Heap profile written to the debug console.");
+}
+
 Command parseCommand(char const *token)
 {
     Command cmd = Command::kUnknown;
@@ -79,6 +86,8 @@ Command parseCommand(char const *token)
         cmd = Command::kSleep;
     } else if (!strcmp(token, "die") || !strcmp(token, "sudoku")) {
         cmd = Command::kDie;
+    } else if (!strcmp(token, "heapprof")) {
+        cmd = Command::kHeapProfile;
     }
 
     return cmd;
@@ -113,6 +122,8 @@ Command readCommand()
             sleep(argv); break;
         case Command::kDie:
             sys_die(); break;
+        case Command::kHeapProfile:
+            heapProfile(); break;
         case Command::kExit: break;
     }
 
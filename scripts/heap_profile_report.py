@@ -0,0 +1,353 @@
+#!/usr/bin/env python3
+"""Symbolise and aggregate a LambOS kernel heap profile.
+
+The kernel writes the profile to the debug console (port 0xE9) as HEAPPROF
+lines; see Kernel::dumpHeapProfile(). Call sites are only recorded in builds
+configured with -DLAMBOS_HEAP_PROFILER=ON.
+
+Example:
+  ./scripts/heap_profile_report.py bochs-debug.log
+  ./scripts/heap_profile_report.py --sort total --top 20 < debugcon.log
+"""
+
+from __future__ import annotations
+
+import argparse
+import json
+import re
+import sys
+from dataclasses import asdict, dataclass, field
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Sequence
+
+from page_fault_report import (
+    AnalysisError,
+    find_repo_root,
+    find_tools,
+    normalize_hex,
+    resolve_build_dirs,
+    resolve_kernel_path,
+    run_tool,
+)
+
+
+@dataclass
+class Site:
+    caller: int
+    allocs: int
+    frees: int
+    live: int
+    peak: int
+    total: int
+    function: str = "??"
+    location: str = "??:0"
+
+
+@dataclass
+class SizeClass:
+    name: str
+    size: int
+    inuse: int
+    capacity: int
+    pages: int
+
+
+@dataclass
+class Profile:
+    totals: Dict[str, int] = field(default_factory=dict)
+    histogram: List[Dict[str, int]] = field(default_factory=list)
+    sites: List[Site] = field(default_factory=list)
+    classes: List[SizeClass] = field(default_factory=list)
+    large: Dict[str, int] = field(default_factory=dict)
+
+
+SORT_KEYS = ("live", "peak", "total", "allocs")
+
+
+def parse_args(argv: Sequence[str]) -> argparse.Namespace:
+    parser = argparse.ArgumentParser(
+        description="Symbolise and aggregate a LambOS kernel heap profile from a debug console log.",
+    )
+    parser.add_argument(
+        "log",
+        nargs="?",
+        help="Debug console log holding HEAPPROF lines. If omitted, read from stdin.",
+    )
+    parser.add_argument(
+        "--dump",
+        type=int,
+        default=-1,
+        help="Which dump to report on when the log holds several, counting from 0 (default: the last).",
+    )
+    parser.add_argument(
+        "--kernel",
+        help="Path to kernel ELF/binary (default: auto-detect build/kernel/kernel.bin).",
+    )
+    parser.add_argument(
+        "--build-dir",
+        dest="build_dirs",
+        action="append",
+        help="Build directory to inspect for CMakeCache.txt and kernel.bin (repeatable).",
+    )
+    parser.add_argument(
+        "--tool-prefix",
+        help="Cross-tool prefix, e.g. i686-elf- or /opt/homebrew/bin/i686-elf-.",
+    )
+    parser.add_argument(
+        "--no-symbols",
+        action="store_true",
+        help="Skip symbolisation and report raw caller addresses.",
+    )
+    parser.add_argument(
+        "--sort",
+        choices=SORT_KEYS,
+        default="live",
+        help="Column to rank call sites and functions by (default: live).",
+    )
+    parser.add_argument(
+        "--top",
+        type=int,
+        default=25,
+        help="Number of call sites and functions to list (default: 25).",
+    )
+    parser.add_argument(
+        "--format",
+        choices=("text", "json"),
+        default="text",
+        help="Output format (default: text).",
+    )
+    return parser.parse_args(argv)
+
+
+def parse_fields(text: str) -> Dict[str, str]:
+    return dict(re.findall(r"(\w+)=(\S+)", text))
+
+
+def to_int(value: str) -> int:
+    return int(value, 0)
+
+
+def split_dumps(log: str) -> List[List[str]]:
+    dumps: List[List[str]] = []
+    current: Optional[List[str]] = None
+    for raw_line in log.splitlines():
+        line = raw_line.strip()
+        index = line.find("HEAPPROF ")
+        if index < 0:
+            continue
+        line = line[index + len("HEAPPROF "):]
+        if line == "BEGIN":
+            current = []
+        elif line == "END":
+            if current is not None:
+                dumps.append(current)
+            current = None
+        elif current is not None:
+            current.append(line)
+    return dumps
+
+
+def parse_dump(lines: Sequence[str]) -> Profile:
+    profile = Profile()
+    class_pattern = re.compile(r"^CLASS name=(.*) size=(\d+) inuse=(\d+) capacity=(\d+) pages=(\d+)$")
+    for line in lines:
+        kind, _, rest = line.partition(" ")
+        if kind == "TOTAL":
+            profile.totals = {key: to_int(value) for key, value in parse_fields(rest).items()}
+        elif kind == "HIST":
+            values = parse_fields(rest)
+            profile.histogram.append({"le": to_int(values["le"]), "count": to_int(values["count"])})
+        elif kind == "SITE":
+            values = parse_fields(rest)
+            profile.sites.append(
+                Site(
+                    caller=to_int(values["caller"]),
+                    allocs=to_int(values["allocs"]),
+                    frees=to_int(values["frees"]),
+                    live=to_int(values["live"]),
+                    peak=to_int(values["peak"]),
+                    total=to_int(values["total"]),
+                )
+            )
+        elif kind == "CLASS":
+            match = class_pattern.match(line)
+            if match:
+                profile.classes.append(
+                    SizeClass(
+                        name=match.group(1),
+                        size=int(match.group(2)),
+                        inuse=int(match.group(3)),
+                        capacity=int(match.group(4)),
+                        pages=int(match.group(5)),
+                    )
+                )
+        elif kind == "LARGE":
+            profile.large = {key: to_int(value) for key, value in parse_fields(rest).items()}
+    return profile
+
+
+def symbolise(sites: Sequence[Site], kernel_path: Path, addr2line: str) -> None:
+    if not sites:
+        return
+
+    # a return address points after the call, so look up the byte before it
+    addresses = [normalize_hex(max(site.caller - 1, 0)) for site in sites]
+    run = run_tool("addr2line", [addr2line, "-f", "-C", "-e", str(kernel_path), *addresses])
+    if run.returncode != 0:
+        raise AnalysisError(f"addr2line failed: {run.stderr or run.stdout}")
+
+    lines = run.stdout.splitlines()
+    for index, site in enumerate(sites):
+        if 2 * index + 1 < len(lines):
+            site.function = lines[2 * index]
+            site.location = lines[2 * index + 1]
+
+
+def aggregate_by_function(sites: Sequence[Site]) -> List[Dict[str, Any]]:
+    functions: Dict[str, Dict[str, Any]] = {}
+    for site in sites:
+        entry = functions.setdefault(
+            site.function,
+            {"function": site.function, "sites": 0, "allocs": 0, "frees": 0, "live": 0, "peak": 0, "total": 0},
+        )
+        entry["sites"] += 1
+        for key in ("allocs", "frees", "live", "total"):
+            entry[key] += getattr(site, key)
+        # the sites didn't necessarily peak together, so this is an upper bound
+        entry["peak"] += site.peak
+    return list(functions.values())
+
+
+def class_report(size_class: SizeClass) -> Dict[str, Any]:
+    used = size_class.inuse * size_class.size
+    reserved = size_class.pages * 4096
+    return {
+        **asdict(size_class),
+        "free_slots": size_class.capacity - size_class.inuse,
+        "utilisation": used / reserved if reserved else 0.0,
+    }
+
+
+def build_report(profile: Profile, sort_key: str, top: int) -> Dict[str, Any]:
+    sites = sorted(profile.sites, key=lambda site: getattr(site, sort_key), reverse=True)
+    functions = sorted(aggregate_by_function(profile.sites), key=lambda entry: entry[sort_key], reverse=True)
+    classes = [class_report(size_class) for size_class in profile.classes]
+
+    slab_pages = sum(size_class.pages for size_class in profile.classes)
+    slab_used = sum(size_class.inuse * size_class.size for size_class in profile.classes)
+    return {
+        "totals": profile.totals,
+        "histogram": profile.histogram,
+        "sites": [dict(asdict(site), caller_hex=normalize_hex(site.caller)) for site in sites[:top]],
+        "functions": functions[:top],
+        "classes": classes,
+        "large": profile.large,
+        "fragmentation": {
+            "slab_pages": slab_pages,
+            "slab_bytes_in_use": slab_used,
+            "slab_utilisation": slab_used / (slab_pages * 4096) if slab_pages else 0.0,
+        },
+    }
+
+
+def render_text_report(report: Dict[str, Any], sort_key: str) -> str:
+    lines: List[str] = []
+    lines.append("Kernel Heap Profile")
+    lines.append("===================")
+    lines.append("")
+
+    totals = report["totals"]
+    if totals:
+        lines.append("Totals")
+        lines.append("------")
+        for key in ("allocs", "frees", "failed", "untracked", "live", "peak"):
+            if key in totals:
+                lines.append(f"{key:>10}: {totals[key]}")
+        lines.append("")
+    else:
+        lines.append("No allocation profile; the kernel was built without LAMBOS_HEAP_PROFILER.")
+        lines.append("")
+
+    if report["histogram"]:
+        lines.append("Size Histogram")
+        lines.append("--------------")
+        for bucket in report["histogram"]:
+            lines.append(f"  <= {bucket['le']:>7}: {bucket['count']}")
+        lines.append("")
+
+    if report["functions"]:
+        lines.append(f"Functions (by {sort_key})")
+        lines.append("-------------------")
+        lines.append(f"{'live':>10} {'peak':>10} {'total':>12} {'allocs':>8} {'frees':>8} {'sites':>5}  function")
+        for entry in report["functions"]:
+            lines.append(
+                f"{entry['live']:>10} {entry['peak']:>10} {entry['total']:>12} {entry['allocs']:>8} "
+                f"{entry['frees']:>8} {entry['sites']:>5}  {entry['function']}"
+            )
+        lines.append("")
+
+    if report["sites"]:
+        lines.append(f"Call Sites (by {sort_key})")
+        lines.append("--------------------")
+        lines.append(f"{'live':>10} {'peak':>10} {'total':>12} {'allocs':>8} {'frees':>8}  caller")
+        for site in report["sites"]:
+            lines.append(
+                f"{site['live']:>10} {site['peak']:>10} {site['total']:>12} {site['allocs']:>8} {site['frees']:>8}  "
+                f"{site['caller_hex']} {site['function']} ({site['location']})"
+            )
+        lines.append("")
+
+    lines.append("Slab Caches")
+    lines.append("-----------")
+    lines.append(f"{'size':>6} {'in use':>8} {'capacity':>8} {'pages':>6} {'used':>6}  cache")
+    for size_class in report["classes"]:
+        if not size_class["pages"]:
+            continue
+        lines.append(
+            f"{size_class['size']:>6} {size_class['inuse']:>8} {size_class['capacity']:>8} {size_class['pages']:>6} "
+            f"{size_class['utilisation']:>6.1%}  {size_class['name']}"
+        )
+    fragmentation = report["fragmentation"]
+    lines.append(
+        f"Slabs hold {fragmentation['slab_bytes_in_use']} bytes of objects in {fragmentation['slab_pages']} pages "
+        f"({fragmentation['slab_utilisation']:.1%} used)."
+    )
+    if report["large"]:
+        lines.append(f"Large blocks: {report['large'].get('blocks', 0)} in {report['large'].get('pages', 0)} pages.")
+
+    return "\n".join(lines).rstrip() + "\n"
+
+
+def main(argv: Sequence[str]) -> int:
+    args = parse_args(argv)
+
+    log = Path(args.log).read_text(encoding="utf-8", errors="replace") if args.log else sys.stdin.read()
+    dumps = split_dumps(log)
+    if not dumps:
+        raise AnalysisError("No complete HEAPPROF BEGIN/END block found in the log.")
+    try:
+        profile = parse_dump(dumps[args.dump])
+    except IndexError:
+        raise AnalysisError(f"The log holds {len(dumps)} dump(s); there is no dump {args.dump}.") from None
+
+    if not args.no_symbols and profile.sites:
+        repo_root = find_repo_root()
+        build_dirs = resolve_build_dirs(repo_root, args.build_dirs)
+        kernel_path = resolve_kernel_path(repo_root, build_dirs, args.kernel)
+        tool_paths, _ = find_tools(build_dirs, args.tool_prefix)
+        symbolise(profile.sites, kernel_path, tool_paths["addr2line"])
+
+    report = build_report(profile, args.sort, args.top)
+    if args.format == "json":
+        print(json.dumps(report, indent=2))
+    else:
+        print(render_text_report(report, args.sort), end="")
+    return 0
+
+
+if __name__ == "__main__":
+    try:
+        raise SystemExit(main(sys.argv[1:]))
+    except AnalysisError as exc:
+        print(f"error: {exc}", file=sys.stderr)
+        raise SystemExit(2)
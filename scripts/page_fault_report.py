@@ -413,12 +413,15 @@ def heuristic_notes(info: PageFaultInfo) -> List[str]:
 
     if info.cr2 < 0x1000:
         notes.append("Fault address is in the first page; this often indicates a null or near-null pointer dereference.")
-    elif info.cr2 >= 0xFFC00000:
-        notes.append("Fault address is in the top 4 MiB; this overlaps common self-map page-table regions on i386.")
+    elif info.cr2 >= 0xF8000000:
+        notes.append("Fault address is in kernel pages above the direct map (kernel heap, slabs, large buffers).")
     elif info.cr2 >= 0xC0000000:
-        notes.append("Fault address is in higher-half kernel virtual space.")
+        notes.append(
+            "Fault address is in the kernel's direct map of physical memory "
+            f"(physical {normalize_hex(info.cr2 - 0xC0000000)}); the kernel image starts at 0xC0100000."
+        )
     else:
-        notes.append("Fault address is in low/user virtual space.")
+        notes.append("Fault address is in user space.")
 
     if info.inferred_bits["protection"]:
         notes.append("Error bit P=1: protection violation (page present but access disallowed).")